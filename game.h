@@ -1,9 +1,12 @@
 #pragma once
 
+#include <emmintrin.h>
 #include "ctk/ctk.h"
 #include "ctk/math.h"
 #include "ctk/memory.h"
 #include "noise_test/vtk.h"
+#include "noise_test/sort_utils.h"
+#include "noise_test/threads.h"
 #include "stk/stk.h"
 
 using namespace ctk;
@@ -16,13 +19,32 @@ struct EntityInfo {
     Pipeline *pipeline;
 };
 
+// Entities sharing a render sort key (pipeline and mesh), drawn with one indirect draw. The cull pass packs the
+// matrixes of visible entities from first_instance in the frame's instance matrixes; instance_count is the group's
+// entity count.
+struct DrawGroup {
+    Pipeline *pipeline;
+    Mesh *mesh;
+    u32 first_instance;
+    u32 instance_count;
+};
+
 struct Pencil {
     u32 color;
     s32 scale;
 };
 
+struct DisplayRect {
+    s32 x;
+    s32 y;
+    s32 width;
+    s32 height;
+};
+
 struct Game {
-    static constexpr u32 MAX_ENTITIES = 1024;
+    static constexpr u32 MAX_ENTITIES = MAX_INSTANCES;
+    static constexpr u32 MAX_DRAW_GROUPS = 64;
+    static constexpr u32 MAX_DIRTY_RECTS = 32;
 
     struct {
         Memory *perm;
@@ -46,22 +68,42 @@ struct Game {
     struct {
         Transform transform[MAX_ENTITIES];
         Matrix model[MAX_ENTITIES];
-        Matrix mvp[MAX_ENTITIES];
         Mesh *mesh[MAX_ENTITIES];
         Pipeline *pipeline[MAX_ENTITIES];
         u32 count;
     } entity_data;
 
+    struct {
+        DrawGroup groups[MAX_DRAW_GROUPS];
+        u32 count;
+    } draw_groups;
+
     struct {
         u32 tri;
         u32 quad;
     } entity;
 
+    // Texels are DISPLAY_TEXEL_SIZES[format] bytes each. Colors passed to drawing functions are texel values: packed
+    // RGBA8 colors, 8-bit palette values or f16 bits.
     struct {
-        u32 *data;
+        DisplayFormat format;
+        u32 texel_size;
+        u8 *data;
         u32 size;
         u32 width;
         u32 height;
+
+        // Regions drawn to since the display was last cleared.
+        DisplayRect dirty_rects[MAX_DIRTY_RECTS];
+        u32 dirty_rect_count;
+
+        // Per frame in flight, regions drawn to or cleared since that frame's display image was last uploaded to,
+        // unless the whole image needs uploading.
+        struct {
+            DisplayRect rects[MAX_DIRTY_RECTS];
+            u32 rect_count;
+            bool all;
+        } uploads[MAX_FRAMES_IN_FLIGHT];
     } display;
 };
 
@@ -180,16 +222,20 @@ static void create_entities(Game *game, Graphics *gfx) {
     });
 }
 
-static void clear_display(Game *game, u32 color) {
-    memset(game->display.data, color, game->display.size * sizeof(u32));
-}
-
 static void create_display(Game *game, Graphics *gfx) {
     VkExtent2D swap_img_extent = gfx->swapchain->extent;
     game->display.width = swap_img_extent.width;
     game->display.height = swap_img_extent.height;
     game->display.size = game->display.width * game->display.height;
-    game->display.data = allocate<u32>(game->mem.perm, game->display.size);
+    game->display.format = gfx->display_format;
+    game->display.texel_size = DISPLAY_TEXEL_SIZES[(u32)gfx->display_format];
+    game->display.data = allocate<u8>(game->mem.perm, game->display.size * game->display.texel_size);
+    game->display.dirty_rect_count = 0;
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        game->display.uploads[i].rect_count = 0;
+        game->display.uploads[i].all = true;
+    }
 }
 
 static Game *create_game(Memory *mem, Graphics *gfx) {
@@ -225,20 +271,251 @@ static void local_translate(Transform *transform, Vec3<f32> translation) {
     transform->position.y += translation.y;
 }
 
-static void draw_point(Game *game, u32 x, u32 y, Pencil p) {
-    for (s32 ny = -(p.scale - 1); ny < p.scale; ++ny)
-    for (s32 nx = -(p.scale - 1); nx < p.scale; ++nx) {
-        s32 pixel_x = x + nx;
-        s32 pixel_y = y + ny;
-
-        if (pixel_x >= 0 && pixel_x < game->display.width &&
-            pixel_y >= 0 && pixel_y < game->display.height)
-        {
-            game->display.data[(pixel_y * game->display.width) + pixel_x] = p.color;
+// Converts to the nearest f16, flushing values below the normal f16 range to 0 and values above it to infinity.
+static u16 f32_to_f16(f32 value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    u32 sign = (bits >> 16) & 0x8000;
+    s32 exponent = (s32)((bits >> 23) & 0xFF) - 127 + 15;
+    u32 mantissa = bits & 0x7FFFFF;
+
+    if (exponent <= 0)
+        return (u16)sign;
+
+    if (exponent >= 31)
+        return (u16)(sign | 0x7C00);
+
+    // Rounding may carry into the exponent, which still gives the right result.
+    return (u16)((sign | (exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+// Encodes a shade in [0, 1] as a texel: gray for RGBA8 displays, or the shade itself for palette-mapped formats.
+static u32 shade_texel(DisplayFormat format, f32 shade) {
+    shade = clamp(shade, 0.0f, 1.0f);
+
+    if (format == DisplayFormat::R16F)
+        return f32_to_f16(shade);
+
+    u32 level = (u32)(255 * shade);
+    if (format == DisplayFormat::R8)
+        return level;
+
+    return 0xFF000000 | (level << 16) | (level << 8) | level;
+}
+
+static inline void store_texel(u8 *dst, u32 texel_size, u32 texel) {
+    // Texels are little-endian, so the low texel_size bytes are the texel.
+    if (texel_size == 4)
+        memcpy(dst, &texel, 4);
+    else if (texel_size == 2)
+        memcpy(dst, &texel, 2);
+    else
+        *dst = (u8)texel;
+}
+
+// Fills count texels 16 bytes at a time. Large fills use non-temporal stores so they don't evict the cache for data
+// that won't be read again before it's uploaded.
+static constexpr u32 NON_TEMPORAL_FILL_MIN_BYTES = 256 * 1024;
+
+static void fill_texels(u8 *texels, u32 count, u32 texel_size, u32 texel) {
+    __m128i pattern = texel_size == 4 ? _mm_set1_epi32((s32)texel) :
+                      texel_size == 2 ? _mm_set1_epi16((s16)texel) :
+                                        _mm_set1_epi8((s8)texel);
+    u32 byte_count = count * texel_size;
+    u32 i = 0;
+
+    if (byte_count >= NON_TEMPORAL_FILL_MIN_BYTES) {
+        // Streaming stores must be 16-byte aligned. Texels are aligned to their size, which divides 16, so the
+        // pattern is still in phase once aligned.
+        for (; i < byte_count && ((uintptr_t)(texels + i) & 15) != 0; i += texel_size)
+            store_texel(texels + i, texel_size, texel);
+
+        for (; i + 16 <= byte_count; i += 16)
+            _mm_stream_si128((__m128i *)(texels + i), pattern);
+
+        _mm_sfence();
+    }
+    else {
+        for (; i + 16 <= byte_count; i += 16)
+            _mm_storeu_si128((__m128i *)(texels + i), pattern);
+    }
+
+    for (; i < byte_count; i += texel_size)
+        store_texel(texels + i, texel_size, texel);
+}
+
+static u8 *display_texel(Game *game, s32 x, s32 y) {
+    return game->display.data + (((y * game->display.width) + x) * game->display.texel_size);
+}
+
+static void fill_display_rect(Game *game, DisplayRect rect, u32 color) {
+    u32 row_pitch = game->display.width * game->display.texel_size;
+    u8 *row = display_texel(game, rect.x, rect.y);
+    for (s32 i = 0; i < rect.height; ++i, row += row_pitch)
+        fill_texels(row, rect.width, game->display.texel_size, color);
+}
+
+static s32 rect_area(DisplayRect rect) {
+    return rect.width * rect.height;
+}
+
+static DisplayRect rect_union(DisplayRect a, DisplayRect b) {
+    s32 min_x = min(a.x, b.x);
+    s32 min_y = min(a.y, b.y);
+    s32 max_x = max(a.x + a.width, b.x + b.width);
+    s32 max_y = max(a.y + a.height, b.y + b.height);
+    return { min_x, min_y, max_x - min_x, max_y - min_y };
+}
+
+// Adds rect to a list of at most Game::MAX_DIRTY_RECTS. Once all slots are used, rect is merged into whichever one
+// grows the least.
+static void add_rect(DisplayRect *rects, u32 *rect_count, DisplayRect rect) {
+    if (*rect_count < Game::MAX_DIRTY_RECTS) {
+        // Skip rects already covered, which is common for views redrawn in place every frame.
+        for (u32 i = 0; i < *rect_count; ++i) {
+            if (rect_area(rect_union(rects[i], rect)) == rect_area(rects[i]))
+                return;
+        }
+
+        rects[(*rect_count)++] = rect;
+        return;
+    }
+
+    u32 best_rect = 0;
+    s32 best_growth = INT32_MAX;
+    for (u32 i = 0; i < *rect_count; ++i) {
+        s32 growth = rect_area(rect_union(rects[i], rect)) - rect_area(rects[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best_rect = i;
+        }
+    }
+
+    rects[best_rect] = rect_union(rects[best_rect], rect);
+}
+
+static bool rects_intersect(DisplayRect a, DisplayRect b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+// Merges intersecting rects until none intersect. Merged rects can grow into others, so merging repeats until a full
+// pass finds nothing to merge.
+static void make_rects_disjoint(DisplayRect *rects, u32 *rect_count) {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+
+        for (u32 i = 0; i < *rect_count; ++i) {
+            for (u32 j = i + 1; j < *rect_count; ++j) {
+                if (!rects_intersect(rects[i], rects[j]))
+                    continue;
+
+                rects[i] = rect_union(rects[i], rects[j]);
+                rects[j] = rects[--(*rect_count)];
+                merged = true;
+                --j;
+            }
         }
     }
 }
 
+static void mark_uploads(Game *game, DisplayRect rect) {
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        add_rect(game->display.uploads[i].rects, &game->display.uploads[i].rect_count, rect);
+}
+
+// Records a clipped rect as drawn, so it's cleared next clear and uploaded to each frame's display image.
+static void mark_dirty(Game *game, DisplayRect rect) {
+    add_rect(game->display.dirty_rects, &game->display.dirty_rect_count, rect);
+    mark_uploads(game, rect);
+}
+
+static void clear_display(Game *game, u32 color) {
+    fill_texels(game->display.data, game->display.size, game->display.texel_size, color);
+    game->display.dirty_rect_count = 0;
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        game->display.uploads[i].all = true;
+}
+
+// Clears only the regions drawn since the last clear, which is usually a small part of the display.
+static void clear_dirty_display(Game *game, u32 color) {
+    for (u32 i = 0; i < game->display.dirty_rect_count; ++i) {
+        fill_display_rect(game, game->display.dirty_rects[i], color);
+        mark_uploads(game, game->display.dirty_rects[i]);
+    }
+
+    game->display.dirty_rect_count = 0;
+}
+
+// Clips rect to display; returns false if nothing is left to draw.
+static bool clip_to_display(Game *game, s32 *x, s32 *y, s32 *width, s32 *height) {
+    s32 min_x = max(*x, 0);
+    s32 min_y = max(*y, 0);
+    s32 max_x = min(*x + *width, (s32)game->display.width);
+    s32 max_y = min(*y + *height, (s32)game->display.height);
+
+    if (min_x >= max_x || min_y >= max_y)
+        return false;
+
+    *x = min_x;
+    *y = min_y;
+    *width = max_x - min_x;
+    *height = max_y - min_y;
+    return true;
+}
+
+static void draw_rect(Game *game, s32 x, s32 y, s32 width, s32 height, u32 color) {
+    if (!clip_to_display(game, &x, &y, &width, &height))
+        return;
+
+    fill_display_rect(game, { x, y, width, height }, color);
+    mark_dirty(game, { x, y, width, height });
+}
+
+static void draw_horizontal_span(Game *game, s32 x, s32 y, s32 width, u32 color) {
+    draw_rect(game, x, y, width, 1, color);
+}
+
+static void draw_vertical_span(Game *game, s32 x, s32 y, s32 height, u32 color) {
+    s32 width = 1;
+    if (!clip_to_display(game, &x, &y, &width, &height))
+        return;
+
+    u32 row_pitch = game->display.width * game->display.texel_size;
+    u8 *texel = display_texel(game, x, y);
+    for (s32 i = 0; i < height; ++i, texel += row_pitch)
+        store_texel(texel, game->display.texel_size, color);
+
+    mark_dirty(game, { x, y, 1, height });
+}
+
+// Copies a width x height block of rows of display-format texels from src (src_stride texels apart) to the display at
+// (x, y).
+static void blit(Game *game, s32 x, s32 y, void *src, s32 width, s32 height, u32 src_stride) {
+    s32 clipped_x = x;
+    s32 clipped_y = y;
+    if (!clip_to_display(game, &clipped_x, &clipped_y, &width, &height))
+        return;
+
+    u32 texel_size = game->display.texel_size;
+    u32 src_pitch = src_stride * texel_size;
+    u32 dst_pitch = game->display.width * texel_size;
+    u8 *src_row = (u8 *)src + (((clipped_y - y) * src_stride) + (clipped_x - x)) * texel_size;
+    u8 *dst_row = display_texel(game, clipped_x, clipped_y);
+
+    for (s32 i = 0; i < height; ++i, src_row += src_pitch, dst_row += dst_pitch)
+        memcpy(dst_row, src_row, width * texel_size);
+
+    mark_dirty(game, { clipped_x, clipped_y, width, height });
+}
+
+static void draw_point(Game *game, u32 x, u32 y, Pencil p) {
+    s32 extent = (p.scale * 2) - 1;
+    draw_rect(game, (s32)x - (p.scale - 1), (s32)y - (p.scale - 1), extent, extent, p.color);
+}
+
 static void controls(Game *game, Graphics *gfx, Window *window) {
     if (key_down(window, Key::ESCAPE)) {
         platform->window->open = false;
@@ -270,15 +547,58 @@ static void controls(Game *game, Graphics *gfx, Window *window) {
         view->transform.rotation.y -= game->input.mouse_delta.x * ROTATION_SPEED;
         view->transform.rotation.x = clamp(view->transform.rotation.x, -view->max_x_angle, view->max_x_angle);
     }
+
+    // Graphics heap usage.
+    if (key_pressed(window, Key::H)) {
+        print_heap_stats("host", gfx->gfx_mem.host);
+        print_heap_stats("device", gfx->gfx_mem.device);
+    }
 }
 
-static void update_display(Game *game, Graphics *gfx) {
-    clear(gfx->gfx_mem.staging);
-    push(gfx, gfx->gfx_mem.staging, game->display.data, game->display.size * sizeof(u32));
+// Records copies of the regions changed since the current frame's display image was last uploaded to. Texels are
+// staged in the current frame's slice of the staging ring, so the display can be drawn to again right away.
+static void update_display(Game *game, Graphics *gfx, VkCommandBuffer cmd_buf) {
+    auto uploads = game->display.uploads + gfx->sync.frame_idx;
+
+    // Copy regions must not overlap.
+    make_rects_disjoint(uploads->rects, &uploads->rect_count);
+
+    DisplayRect full_rect = { 0, 0, (s32)game->display.width, (s32)game->display.height };
+    DisplayRect *rects = uploads->all ? &full_rect : uploads->rects;
+    u32 rect_count = uploads->all ? 1 : uploads->rect_count;
+
+    if (rect_count > 0) {
+        u32 texel_size = game->display.texel_size;
+        u32 display_pitch = game->display.width * texel_size;
+        VkBufferImageCopy copies[Game::MAX_DIRTY_RECTS] = {};
+
+        for (u32 i = 0; i < rect_count; ++i) {
+            DisplayRect rect = rects[i];
+            VkBufferImageCopy *copy = copies + i;
+
+            // Rows are packed tightly in staging.
+            u32 row_size = rect.width * texel_size;
+            u8 *staging = allocate_staging(gfx, row_size * rect.height, 16, &copy->bufferOffset);
+            u8 *row = display_texel(game, rect.x, rect.y);
+            for (s32 y = 0; y < rect.height; ++y, staging += row_size, row += display_pitch)
+                memcpy(staging, row, row_size);
+
+            copy->bufferRowLength = 0;
+            copy->bufferImageHeight = 0;
+            copy->imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy->imageSubresource.mipLevel = 0;
+            copy->imageSubresource.baseArrayLayer = 0;
+            copy->imageSubresource.layerCount = 1;
+            copy->imageOffset = { rect.x, rect.y, 0 };
+            copy->imageExtent = { (u32)rect.width, (u32)rect.height, 1 };
+        }
 
-    begin_temp_cmd_buf(gfx->temp_cmd_buf);
-        copy_to_image(gfx->temp_cmd_buf, gfx->gfx_mem.staging->mem->buffer, 0, gfx->image.display);
-    submit_temp_cmd_buf(gfx->temp_cmd_buf, gfx->queue.graphics);
+        copy_regions_to_image(cmd_buf, gfx->gfx_mem.staging->mem->buffer, gfx->image.display[gfx->sync.frame_idx],
+                              copies, rect_count);
+    }
+
+    uploads->rect_count = 0;
+    uploads->all = false;
 }
 
 static Matrix calculate_view_space_matrix(View *view) {
@@ -298,8 +618,6 @@ static Matrix calculate_view_space_matrix(View *view) {
 }
 
 static void update_entity_data(Game *game) {
-    Matrix view_space_matrix = calculate_view_space_matrix(game->view);
-
     // Calculate entity model matrixes.
     for (u32 i = 0; i < game->entity_data.count; ++i) {
         Transform *transform = game->entity_data.transform + i;
@@ -311,7 +629,7 @@ static void update_entity_data(Game *game) {
         model_matrix = rotate(model_matrix, transform->rotation.z, Axis::Z);
         model_matrix = scale(model_matrix, transform->scale);
 
-        game->entity_data.mvp[i] = view_space_matrix * model_matrix;
+        game->entity_data.model[i] = model_matrix;
     }
 }
 
@@ -332,30 +650,175 @@ static void update_descriptor_data(Game *game, Graphics *gfx) {
     // submit_temp_cmd_buf(gfx->temp_cmd_buf, gfx->queue.graphics);
 }
 
-static void record_render_cmds(Game *game, Graphics *gfx) {
-    VkCommandBuffer cmd_buf = gfx->primary_render_cmd_bufs->data[gfx->sync.swap_img_idx];
-    begin_render_cmds(gfx, cmd_buf);
-    for (u32 i = 0; i < game->entity_data.count; ++i) {
-        // Pipeline Binding
-        Pipeline *pipeline = game->entity_data.pipeline[i];
-        vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->handle);
+// Mesh block is most significant, so each block's vertex and index buffers are bound once per command buffer, then
+// pipeline (which determines descriptor sets), then the mesh's index offset, unique among meshes pushed to a block.
+static u64 render_sort_key(Pipeline *pipeline, Mesh *mesh) {
+    CTK_ASSERT(mesh->block != U32_MAX);
+    return ((u64)mesh->block << 48) | ((u64)pipeline->id << 32) | mesh->index_range.offset;
+}
+
+// Sorts entities by render sort key and writes them to the frame's cull entities in sorted order, so draw groups are
+// runs of equal keys, already in bind order, and each group's instance range is the run's range.
+static void update_cull_data(Game *game, Graphics *gfx) {
+    u32 entity_count = game->entity_data.count;
+    CTK_ASSERT(entity_count <= MAX_INSTANCES);
+
+    game->draw_groups.count = 0;
+    if (entity_count == 0)
+        return;
+
+    push_frame(game->mem.temp);
+
+    u64 *keys = allocate<u64>(game->mem.temp, entity_count);
+    u32 *entities = allocate<u32>(game->mem.temp, entity_count);
+    for (u32 i = 0; i < entity_count; ++i) {
+        keys[i] = render_sort_key(game->entity_data.pipeline[i], game->entity_data.mesh[i]);
+        entities[i] = i;
+    }
+
+    radix_sort(game->mem.temp, keys, entities, entity_count);
+
+    CullEntity *cull_entities = get_cull_entities(gfx);
+    for (u32 i = 0; i < entity_count; ++i) {
+        u32 entity = entities[i];
+        Mesh *mesh = game->entity_data.mesh[entity];
+
+        if (i == 0 || keys[i] != keys[i - 1]) {
+            if (game->draw_groups.count == Game::MAX_DRAW_GROUPS)
+                CTK_FATAL("cannot add draw group: already at max draw group count of %u", Game::MAX_DRAW_GROUPS);
+
+            game->draw_groups.groups[game->draw_groups.count] = {
+                .pipeline = game->entity_data.pipeline[entity],
+                .mesh = mesh,
+                .first_instance = i,
+                .instance_count = 0,
+            };
+            ++game->draw_groups.count;
+        }
+
+        u32 group_idx = game->draw_groups.count - 1;
+        ++game->draw_groups.groups[group_idx].instance_count;
+        cull_entities[i] = {
+            .model = game->entity_data.model[entity],
+            .bounds_center = mesh->bounds_center,
+            .bounds_radius = mesh->bounds_radius,
+            .draw = group_idx,
+        };
+    }
+
+    pop_frame(game->mem.temp);
+}
+
+// Waking a worker and executing its secondary command buffer cost more than recording a few runs.
+static constexpr u32 MIN_DRAW_RUNS_PER_RENDER_THREAD = 4;
+
+// Finds runs of draw groups sharing a pipeline and mesh block, which are drawn with one draw_indirect(). Run i is
+// groups [run_starts[i], run_starts[i + 1]).
+static u32 find_draw_runs(Game *game, u32 *run_starts) {
+    u32 run_count = 0;
+
+    for (u32 i = 0; i < game->draw_groups.count; ++i) {
+        if (i > 0) {
+            DrawGroup *group = game->draw_groups.groups + i;
+            DrawGroup *prev_group = group - 1;
 
-        if (pipeline == gfx->pipeline.texture) {
+            if (group->pipeline == prev_group->pipeline && group->mesh->block == prev_group->mesh->block)
+                continue;
+        }
+
+        run_starts[run_count++] = i;
+    }
+
+    run_starts[run_count] = game->draw_groups.count;
+    return run_count;
+}
+
+// Records runs [first_run, end_run) into a render thread's command buffer. Groups are sorted by mesh block then
+// pipeline, so state is only bound when it changes.
+static void record_draw_runs(Game *game, Graphics *gfx, VkCommandBuffer cmd_buf, u32 *run_starts, u32 first_run,
+                             u32 end_run)
+{
+    u32 bound_block = U32_MAX;
+    Pipeline *bound_pipeline = NULL;
+    u32 bound_descriptor_set_count = 0;
+
+    for (u32 run = first_run; run < end_run; ++run) {
+        DrawGroup *group = game->draw_groups.groups + run_starts[run];
+        Pipeline *pipeline = group->pipeline;
+        u32 block = group->mesh->block;
+
+        if (block != bound_block) {
+            bound_block = block;
+            bind_mesh_data(gfx, cmd_buf, bound_block);
+        }
+
+        if (pipeline != bound_pipeline) {
+            bound_pipeline = pipeline;
+            vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_pipeline->handle);
+
+            // Instance matrixes are set 0 for all entity pipelines; the texture pipeline adds the display as set 1.
+            // Entity pipeline layouts have no push constants and share set layouts, so bound sets stay valid across
+            // pipelines and only sets not yet bound are bound.
             VkDescriptorSet descriptor_sets[] = {
-                gfx->descriptor_set.texture->handles[0],
+                gfx->descriptor_set.instances->handles[gfx->sync.frame_idx],
+                gfx->descriptor_set.texture->handles[gfx->sync.frame_idx],
             };
-            vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout,
-                                    0, CTK_ARRAY_SIZE(descriptor_sets), descriptor_sets,
-                                    0, NULL);
+            u32 descriptor_set_count = bound_pipeline == gfx->pipeline.texture ? 2 : 1;
+            if (descriptor_set_count > bound_descriptor_set_count) {
+                vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_pipeline->layout,
+                                        bound_descriptor_set_count,
+                                        descriptor_set_count - bound_descriptor_set_count,
+                                        descriptor_sets + bound_descriptor_set_count,
+                                        0, NULL);
+                bound_descriptor_set_count = descriptor_set_count;
+            }
         }
 
-        vkCmdPushConstants(cmd_buf, gfx->pipeline.test->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 64,
-                           game->entity_data.mvp + i);
+        draw_indirect(gfx, cmd_buf, run_starts[run], run_starts[run + 1] - run_starts[run]);
+    }
+}
 
-        // Mesh Drawing
-        bind_mesh_data(gfx, cmd_buf);
-        draw_mesh(gfx, cmd_buf, game->entity_data.mesh[i]);
+static void record_render_cmds(Game *game, Graphics *gfx) {
+    CTK_ASSERT(Game::MAX_DRAW_GROUPS <= MAX_CULL_DRAWS);
+
+    update_cull_data(game, gfx);
+
+    // Draw commands start with no instances; the cull pass counts visible entities into them.
+    VkDrawIndexedIndirectCommand draws[Game::MAX_DRAW_GROUPS];
+    for (u32 i = 0; i < game->draw_groups.count; ++i) {
+        DrawGroup *group = game->draw_groups.groups + i;
+        draws[i] = {
+            .indexCount = group->mesh->index_range.count,
+            .instanceCount = 0,
+            .firstIndex = group->mesh->index_range.offset,
+            .vertexOffset = (s32)group->mesh->vertex_range.offset,
+            .firstInstance = group->first_instance,
+        };
     }
 
+    VkCommandBuffer cmd_buf = begin_frame_cmds(gfx);
+    update_display(game, gfx, cmd_buf);
+    record_cull_cmds(gfx, cmd_buf, calculate_view_space_matrix(game->view), game->entity_data.count,
+                     draws, game->draw_groups.count);
+    begin_render_cmds(gfx, cmd_buf);
+
+    // Draw runs are split evenly across render threads, each given at least MIN_DRAW_RUNS_PER_RENDER_THREAD runs
+    // unless there is only one.
+    u32 run_starts[Game::MAX_DRAW_GROUPS + 1];
+    u32 run_count = find_draw_runs(game, run_starts);
+    u32 thread_count = min(run_count / MIN_DRAW_RUNS_PER_RENDER_THREAD, gfx->render_thread_count);
+    if (thread_count == 0 && run_count > 0)
+        thread_count = 1;
+
+    parallel_for(thread_count, [&](u32 thread_idx) {
+        VkCommandBuffer thread_cmd_buf = begin_render_thread_cmds(gfx, thread_idx);
+        record_draw_runs(game, gfx, thread_cmd_buf, run_starts,
+                         (run_count * thread_idx) / thread_count,
+                         (run_count * (thread_idx + 1)) / thread_count);
+        end_render_thread_cmds(thread_cmd_buf);
+    });
+
+    execute_render_thread_cmds(gfx, cmd_buf, thread_count);
+
     end_render_cmds(gfx, cmd_buf);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <math.h>
 #define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.h>
 
@@ -8,6 +9,7 @@
 #include "ctk/containers.h"
 #include "ctk/file.h"
 #include "noise_test/vtk.h"
+#include "noise_test/threads.h"
 #include "stk/stk.h"
 
 using namespace ctk;
@@ -17,20 +19,83 @@ using namespace stk;
 ////////////////////////////////////////////////////////////
 /// Data
 ////////////////////////////////////////////////////////////
+struct GraphicsHeap;
+
 struct GraphicsMemory {
     Buffer *buffer;
     VkDeviceSize offset;
     VkDeviceSize size;
+    u8 *mapped; // Host address of offset; HOST memory stays mapped for its lifetime. NULL for DEVICE memory.
 
     enum struct Type {
         HOST,
         DEVICE,
     } type;
+
+    GraphicsHeap *heap; // Heap memory was allocated from, for free_graphics_memory().
 };
 
-struct GraphicsStack {
-    GraphicsMemory *mem;
-    VkDeviceSize count;
+// Graphics heaps sub-allocate buffers created in large blocks using a two-level segregated fit (TLSF) allocator. Free
+// ranges are kept in lists binned by size class, with bitmaps of non-empty lists, so allocating and freeing take
+// constant time. Freed ranges merge with free neighbours in the same block.
+static constexpr VkDeviceSize HEAP_MIN_ALLOCATION = 16; // Range offsets and sizes are multiples of this.
+static constexpr u32 HEAP_SL_BITS = 4; // Each power-of-two size range is split into 2^HEAP_SL_BITS classes.
+static constexpr u32 HEAP_SL_COUNT = 1 << HEAP_SL_BITS;
+static constexpr u32 HEAP_SMALL_SHIFT = 8; // Sizes below HEAP_SL_COUNT * HEAP_MIN_ALLOCATION are binned linearly.
+static constexpr VkDeviceSize HEAP_SMALL_SIZE = 1 << HEAP_SMALL_SHIFT;
+static constexpr u32 HEAP_FL_COUNT = 32;
+static constexpr u32 HEAP_MAX_BLOCKS = 16;
+static constexpr u32 HEAP_MAX_NODES = 4096;
+static constexpr u32 HEAP_NULL_NODE = U32_MAX;
+
+// Allocated or free range of a heap block. Nodes are linked to neighbouring ranges in their block, and while free to
+// the other ranges in their size class. Nodes merged away are linked into the heap's unused node list by next_free.
+struct HeapNode {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    u32 block;
+    u32 prev_range;
+    u32 next_range;
+    u32 prev_free;
+    u32 next_free;
+    bool free;
+    bool in_use; // Set from allocate() until free_graphics_memory(); never set for free or unused nodes.
+};
+
+struct HeapBlock {
+    Buffer *buffer;
+    VkDeviceSize size;
+    u8 *mapped;
+};
+
+struct GraphicsHeap {
+    BufferInfo buffer_info; // size is the size of blocks added as the heap grows.
+    GraphicsMemory::Type type;
+    FixedArray<HeapBlock, HEAP_MAX_BLOCKS> blocks;
+
+    // handles[i] is the GraphicsMemory returned for nodes[i], so handles are recycled along with their nodes.
+    HeapNode *nodes;
+    GraphicsMemory *handles;
+    u32 node_count;
+    u32 unused_nodes;
+
+    u32 fl_bitmap;
+    u32 sl_bitmaps[HEAP_FL_COUNT];
+    u32 free_lists[HEAP_FL_COUNT][HEAP_SL_COUNT];
+
+    u32 allocation_count;
+    VkDeviceSize allocated_bytes;
+};
+
+struct GraphicsHeapStats {
+    u32 block_count;
+    VkDeviceSize block_bytes;
+    u32 allocation_count;
+    VkDeviceSize allocated_bytes;
+    u32 free_range_count;
+    VkDeviceSize free_bytes;
+    VkDeviceSize largest_free_range;
+    f32 fragmentation; // 1 - largest_free_range / free_bytes; 0 while free space in the heap is contiguous.
 };
 
 template<typename Type>
@@ -40,6 +105,15 @@ struct GraphicsArray {
     VkDeviceSize size;
 };
 
+// Host memory uploads are staged in, used as a ring. Uploads are allocated at head, and each frame records head when
+// it is submitted; once that frame's in_flight fence has signalled, tail moves up to the recorded head. head == tail
+// when empty, so allocations never fill the ring completely.
+struct StagingRing {
+    GraphicsMemory *mem;
+    VkDeviceSize head;
+    VkDeviceSize tail;
+};
+
 struct Shader {
     VkShaderModule handle;
     VkShaderStageFlagBits stage;
@@ -68,6 +142,9 @@ struct PipelineInfo {
     VkPipelineRasterizationStateCreateInfo rasterization;
     VkPipelineMultisampleStateCreateInfo   multisample;
     VkPipelineColorBlendStateCreateInfo    color_blend;
+
+    // Applied to every shader stage if set.
+    VkSpecializationInfo *specialization;
 };
 
 struct DescriptorSet {
@@ -80,12 +157,50 @@ struct DescriptorSet {
 struct Pipeline {
     VkPipeline handle;
     VkPipelineLayout layout;
+    u32 id; // Creation order, used in render queue sort keys.
+};
+
+static constexpr u32 MAX_UPLOADS = 8;
+static constexpr u32 MAX_OWNERSHIP_ACQUIRES = 256;
+static constexpr u32 MAX_UPLOAD_RELEASES = 16; // Buffer ranges a single transfer upload may release.
+
+// Queue an upload is submitted to. Transfer uploads may only record copies between buffers, and go to the graphics
+// queue on devices without a dedicated transfer queue family or while the next frame's acquires are nearly full.
+enum struct UploadQueue {
+    GRAPHICS,
+    TRANSFER,
+};
+
+// Command buffers and sync for an upload submission. cmd_buf is whichever of graphics_cmd_buf and transfer_cmd_buf
+// the upload was begun with.
+struct Upload {
+    VkCommandBuffer graphics_cmd_buf;
+    VkCommandBuffer transfer_cmd_buf;
+    VkCommandBuffer cmd_buf;
+    bool transfer;
+    u32 release_count;
+    VkFence fence;
+    VkSemaphore finished;
+};
+
+// Each frame in flight has its own render command buffer and display image, so recording a frame never touches
+// anything the GPU may still be using for the other.
+static constexpr u32 MAX_FRAMES_IN_FLIGHT = 2;
+
+static constexpr u32 MAX_RENDER_THREADS = 8;
+
+// Each render thread records a secondary command buffer from its own pool, so threads record without synchronizing.
+// Pools are per frame in flight and reset once the frame's in_flight fence has signalled.
+struct RenderThread {
+    VkCommandPool cmd_pool;
+    VkCommandBuffer cmd_buf;
 };
 
 struct Frame {
     VkSemaphore img_aquired;
     VkSemaphore render_finished;
     VkFence in_flight;
+    VkDeviceSize staging_end; // Staging ring head when the frame was submitted.
 };
 
 struct Transform {
@@ -99,16 +214,125 @@ struct Vertex {
     Vec2<f32> uv;
 };
 
+// Compact vertex for grid terrain: x/z are grid coordinates scaled by the terrain pipeline's grid spacing, height is
+// normalized to [0, 65535] and scaled by its height scale, and normal is octahedral-encoded as 2 x 8-bit components.
+struct TerrainVertex {
+    u16 x;
+    u16 z;
+    u16 height;
+    u16 normal;
+};
+
+struct TerrainPushConstants {
+    Matrix mvp;
+    f32 grid_spacing;
+    f32 height_scale;
+    f32 _pad[2];
+};
+
 struct MeshInfo {
     u32 max_vertex_count;
     u32 max_index_count;
 };
 
+static constexpr u32 MAX_MESH_BLOCKS = 16;
+
+// Range of elements in a mesh block's vertex or index array.
+struct MeshRange {
+    u32 offset;
+    u32 count;
+};
+
+static constexpr u32 MAX_FREE_MESH_RANGES = 1024;
+static constexpr u32 MAX_PENDING_MESH_FREES = 256;
+
+// Ranges of a freed mesh, waiting to be returned to their block's free lists.
+struct PendingMeshFree {
+    Array<MeshRange> *free_vertex_ranges;
+    Array<MeshRange> *free_index_ranges;
+    MeshRange vertex_range;
+    MeshRange index_range;
+};
+
+// Chained blocks left with no mesh data are released: their arrays' memory is returned to the device heap, leaving
+// vertexes->mem NULL, and the slot is reused by the next block pushed so block indexes stay stable.
+template<typename VertexType>
+struct MeshBlock {
+    GraphicsArray<VertexType> *vertexes;
+    GraphicsArray<u32> *indexes;
+
+    // Sorted by offset; adjacent ranges are always coalesced.
+    Array<MeshRange> *free_vertex_ranges;
+    Array<MeshRange> *free_index_ranges;
+};
+
+template<typename VertexType>
+struct MeshArena {
+    FixedArray<MeshBlock<VertexType>, MAX_MESH_BLOCKS> blocks;
+    u32 block_vertex_count;
+    u32 block_index_count;
+};
+
 struct Mesh {
     Array<Vertex> *vertexes;
     Array<u32> *indexes;
-    u32 vertex_offset;
-    u32 index_offset;
+
+    // Location of mesh data on device (block is U32_MAX if mesh data hasn't been pushed).
+    u32 block;
+    MeshRange vertex_range;
+    MeshRange index_range;
+
+    // Model space bounding sphere of vertexes, calculated when mesh data is pushed.
+    Vec3<f32> bounds_center;
+    f32 bounds_radius;
+};
+
+struct TerrainMesh {
+    Array<TerrainVertex> *vertexes;
+    Array<u32> *indexes;
+    u32 block;
+    MeshRange vertex_range;
+    MeshRange index_range;
+};
+
+// Display texel formats, indexed into DISPLAY_VK_FORMATS and DISPLAY_TEXEL_SIZES. Single-channel formats are mapped to
+// color through the display palette in texture.frag, so the CPU writes and uploads 1 or 2 bytes per pixel instead of 4.
+enum struct DisplayFormat {
+    RGBA8,
+    R8,
+    R16F,
+};
+
+static constexpr VkFormat DISPLAY_VK_FORMATS[] = {
+    VK_FORMAT_R8G8B8A8_UNORM,
+    VK_FORMAT_R8_UNORM,
+    VK_FORMAT_R16_SFLOAT,
+};
+
+static constexpr u32 DISPLAY_TEXEL_SIZES[] = { 4, 1, 2 };
+static constexpr u32 MAX_DISPLAY_TEXEL_SIZE = 4;
+
+// Palette entries are RGBA8 colors spread evenly over display values in [0, 1].
+static constexpr u32 DISPLAY_PALETTE_SIZE = 256;
+
+// Instanced draws read MVP matrixes from the current frame's instance array, indexed by gl_InstanceIndex. The cull
+// pass writes them, packing each draw command's visible instances from its firstInstance.
+static constexpr u32 MAX_INSTANCES = 131072;
+static constexpr u32 MAX_CULL_DRAWS = 256; // Draw commands are reset with vkCmdUpdateBuffer, which is limited to 64KB.
+static constexpr u32 CULL_GROUP_SIZE = 64; // Must match cull.comp's local_size_x.
+
+// Matches cull.comp's Entity (std430). draw is the index of the draw command the entity is an instance of.
+struct CullEntity {
+    Matrix model;
+    Vec3<f32> bounds_center;
+    f32 bounds_radius;
+    u32 draw;
+    u32 _pad[3];
+};
+
+struct CullPushConstants {
+    Matrix view_projection;
+    u32 entity_count;
 };
 
 struct View {
@@ -128,25 +352,42 @@ struct Graphics {
     VkSurfaceKHR surface;
     PhysicalDevice *physical_device;
     VkDevice device;
+    bool multi_draw_indirect; // multiDrawIndirect is supported and enabled.
 
     struct {
         VkQueue graphics;
         VkQueue present;
+        VkQueue transfer; // Same as graphics if the device has no dedicated transfer queue family.
     } queue;
 
     Swapchain *swapchain;
     VkCommandPool main_cmd_pool;
-    VkCommandBuffer temp_cmd_buf;
+    VkCommandPool transfer_cmd_pool; // VK_NULL_HANDLE if the device has no dedicated transfer queue family.
 
+    // Uploads are recorded into command buffers recycled round-robin and submitted without waiting. Each submission
+    // waits GPU-side on the last upload, so uploads complete in order and rendering never sees a partial upload.
     struct {
-        GraphicsStack *host;
-        GraphicsStack *device;
-        GraphicsArray<u8> *staging;
+        Upload uploads[MAX_UPLOADS];
+        u32 next;
+        Upload *current;
+        VkSemaphore pending; // Last upload's finished semaphore until a submission has waited on it.
+
+        // Graphics queue acquires of buffer ranges released by transfer uploads, recorded at the start of the next
+        // frame, which waits on the uploads.
+        FixedArray<VkBufferMemoryBarrier, MAX_OWNERSHIP_ACQUIRES> acquires;
+    } upload;
+
+    struct {
+        GraphicsHeap *host;
+        GraphicsHeap *device;
+        StagingRing *staging;
     } gfx_mem;
 
     RenderPass *render_pass;
     Array<VkFramebuffer> *framebuffers;
-    Array<VkCommandBuffer> *primary_render_cmd_bufs;
+    Array<VkCommandBuffer> *primary_render_cmd_bufs; // Indexed by sync.frame_idx.
+    RenderThread render_threads[MAX_FRAMES_IN_FLIGHT][MAX_RENDER_THREADS];
+    u32 render_thread_count;
 
     struct {
         u32 swap_img_idx;
@@ -156,34 +397,53 @@ struct Graphics {
     } sync;
 
     // Render State
-    struct {
-        GraphicsArray<Vertex> *vertexes;
-        GraphicsArray<u32> *indexes;
-    } mesh_data;
+    MeshArena<Vertex> mesh_data;
+    MeshArena<TerrainVertex> terrain_mesh_data;
+
+    // Mesh ranges freed during each frame. Frames still in flight may be drawing from them, so they are only returned
+    // to their free lists once the frame's in_flight fence has signalled. Indexed by sync.frame_idx.
+    FixedArray<PendingMeshFree, MAX_PENDING_MESH_FREES> pending_mesh_frees[MAX_FRAMES_IN_FLIGHT];
 
     struct {
         ShaderGroup test;
         ShaderGroup texture;
+        ShaderGroup terrain;
+        Shader *cull;
     } shader;
 
+    DisplayFormat display_format;
+
     struct {
-        Image *display;
+        Image *display[MAX_FRAMES_IN_FLIGHT];
+        Image *palette;
     } image;
 
     struct {
         VkSampler nearest;
+        VkSampler palette;
     } sampler;
 
     VkDescriptorPool descriptor_pool;
 
+    // One array per frame in flight. Cull entities are host memory, so they are written in place; draw commands and
+    // instance matrixes are device memory written by the cull pass.
+    GraphicsArray<CullEntity> *cull_entities[MAX_FRAMES_IN_FLIGHT];
+    GraphicsArray<VkDrawIndexedIndirectCommand> *draw_commands[MAX_FRAMES_IN_FLIGHT];
+    GraphicsArray<Matrix> *instance_matrixes[MAX_FRAMES_IN_FLIGHT];
+
     struct {
+        DescriptorSet *instances;
         DescriptorSet *texture;
+        DescriptorSet *cull;
     } descriptor_set;
 
     struct {
         Pipeline *test;
         Pipeline *texture;
+        Pipeline *terrain;
+        Pipeline *cull;
     } pipeline;
+    u32 pipeline_count;
 };
 
 #include "noise_test/graphics_defaults.h"
@@ -191,83 +451,563 @@ struct Graphics {
 ////////////////////////////////////////////////////////////
 /// Utils
 ////////////////////////////////////////////////////////////
-static GraphicsStack *create_graphics_stack(Graphics *gfx, BufferInfo buffer_info) {
-    auto mem = allocate<GraphicsMemory>(gfx->mem.perm, 1);
-    mem->buffer = create_buffer(allocate<Buffer>(gfx->mem.perm, 1), gfx->device, gfx->physical_device, buffer_info);
-    mem->offset = 0;
-    mem->size = buffer_info.size;
-    if ((buffer_info.mem_property_flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-        mem->type = GraphicsMemory::Type::DEVICE;
+static u32 lowest_set_bit(u32 bits) {
+    // De Bruijn sequence lookup of the isolated bit.
+    static constexpr u32 DE_BRUIJN_BIT_POSITIONS[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9,
+    };
+
+    CTK_ASSERT(bits != 0);
+    return DE_BRUIJN_BIT_POSITIONS[((bits & (0 - bits)) * 0x077CB531u) >> 27];
+}
+
+static u32 highest_set_bit(VkDeviceSize value) {
+    CTK_ASSERT(value != 0);
+
+    u32 bit = 0;
+    for (u32 shift = 32; shift > 0; shift /= 2) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+
+    return bit;
+}
+
+static void heap_size_class(VkDeviceSize size, u32 *fl, u32 *sl) {
+    if (size < HEAP_SMALL_SIZE) {
+        *fl = 0;
+        *sl = (u32)(size / HEAP_MIN_ALLOCATION);
+    }
+    else {
+        u32 msb = highest_set_bit(size);
+        *fl = msb - HEAP_SMALL_SHIFT + 1;
+        *sl = (u32)(size >> (msb - HEAP_SL_BITS)) ^ HEAP_SL_COUNT;
+    }
+}
+
+// Rounds size up to the start of a size class, so every range in that class and above is at least size bytes.
+static VkDeviceSize round_to_size_class(VkDeviceSize size) {
+    if (size < HEAP_SMALL_SIZE)
+        return size;
+
+    VkDeviceSize class_size = (VkDeviceSize)1 << (highest_set_bit(size) - HEAP_SL_BITS);
+    return (size + class_size - 1) & ~(class_size - 1);
+}
+
+static void insert_free_node(GraphicsHeap *heap, u32 node_idx) {
+    HeapNode *node = heap->nodes + node_idx;
+    u32 fl = 0;
+    u32 sl = 0;
+    heap_size_class(node->size, &fl, &sl);
+
+    node->free = true;
+    node->prev_free = HEAP_NULL_NODE;
+    node->next_free = heap->free_lists[fl][sl];
+    if (node->next_free != HEAP_NULL_NODE)
+        heap->nodes[node->next_free].prev_free = node_idx;
+
+    heap->free_lists[fl][sl] = node_idx;
+    heap->fl_bitmap |= 1u << fl;
+    heap->sl_bitmaps[fl] |= 1u << sl;
+}
+
+static void remove_free_node(GraphicsHeap *heap, u32 node_idx) {
+    HeapNode *node = heap->nodes + node_idx;
+    u32 fl = 0;
+    u32 sl = 0;
+    heap_size_class(node->size, &fl, &sl);
+
+    if (node->prev_free != HEAP_NULL_NODE)
+        heap->nodes[node->prev_free].next_free = node->next_free;
     else
-        mem->type = GraphicsMemory::Type::HOST;
+        heap->free_lists[fl][sl] = node->next_free;
 
-    auto stack = allocate<GraphicsStack>(gfx->mem.perm, 1);
-    stack->mem = mem;
-    stack->count = 0;
+    if (node->next_free != HEAP_NULL_NODE)
+        heap->nodes[node->next_free].prev_free = node->prev_free;
+
+    if (heap->free_lists[fl][sl] == HEAP_NULL_NODE) {
+        heap->sl_bitmaps[fl] &= ~(1u << sl);
+        if (heap->sl_bitmaps[fl] == 0)
+            heap->fl_bitmap &= ~(1u << fl);
+    }
 
-    return stack;
+    node->free = false;
 }
 
-static GraphicsMemory *allocate(Graphics *gfx, GraphicsStack *stack, VkDeviceSize size, VkDeviceSize align) {
-    VkDeviceSize align_overflow = stack->count % align;
-    VkDeviceSize align_offset = stack->count + (align_overflow ? align - align_overflow : 0);
+// Returns a free node of at least size bytes from the smallest non-empty size class that guarantees one.
+static u32 find_free_node(GraphicsHeap *heap, VkDeviceSize size) {
+    u32 fl = 0;
+    u32 sl = 0;
+    heap_size_class(round_to_size_class(size), &fl, &sl);
+    if (fl >= HEAP_FL_COUNT)
+        return HEAP_NULL_NODE;
+
+    u32 sl_bits = heap->sl_bitmaps[fl] & (~0u << sl);
+    if (sl_bits == 0) {
+        u32 fl_bits = fl + 1 < HEAP_FL_COUNT ? heap->fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (fl_bits == 0)
+            return HEAP_NULL_NODE;
+
+        fl = lowest_set_bit(fl_bits);
+        sl_bits = heap->sl_bitmaps[fl];
+    }
+
+    return heap->free_lists[fl][lowest_set_bit(sl_bits)];
+}
 
-    if (align_offset + size > stack->mem->size) {
-        CTK_FATAL("allocating %u bytes aligned by %u to offset %u on stack (size=%u) would overflow by %u bytes",
-                  size, align, align_offset, stack->mem->size, align_offset + size - stack->mem->size);
+static u32 take_node(GraphicsHeap *heap) {
+    if (heap->unused_nodes != HEAP_NULL_NODE) {
+        u32 node_idx = heap->unused_nodes;
+        heap->unused_nodes = heap->nodes[node_idx].next_free;
+        heap->nodes[node_idx].in_use = false;
+        return node_idx;
     }
 
-    stack->count = align_offset + size;
+    if (heap->node_count == HEAP_MAX_NODES)
+        CTK_FATAL("cannot take heap node: already at max heap node count of %u", HEAP_MAX_NODES);
+
+    heap->nodes[heap->node_count].in_use = false;
+    return heap->node_count++;
+}
+
+// Splits node after size bytes, returning the node for the rest of its range.
+static u32 split_node(GraphicsHeap *heap, u32 node_idx, VkDeviceSize size) {
+    u32 rest_idx = take_node(heap);
+    HeapNode *node = heap->nodes + node_idx;
+    HeapNode *rest = heap->nodes + rest_idx;
+
+    rest->offset = node->offset + size;
+    rest->size = node->size - size;
+    rest->block = node->block;
+    rest->prev_range = node_idx;
+    rest->next_range = node->next_range;
+    rest->free = false;
+    if (rest->next_range != HEAP_NULL_NODE)
+        heap->nodes[rest->next_range].prev_range = rest_idx;
+
+    node->size = size;
+    node->next_range = rest_idx;
+    return rest_idx;
+}
+
+// Merges the range after node into it, recycling the merged node.
+static void merge_next_node(GraphicsHeap *heap, u32 node_idx) {
+    HeapNode *node = heap->nodes + node_idx;
+    u32 next_idx = node->next_range;
+    HeapNode *next = heap->nodes + next_idx;
+
+    node->size += next->size;
+    node->next_range = next->next_range;
+    if (node->next_range != HEAP_NULL_NODE)
+        heap->nodes[node->next_range].prev_range = node_idx;
+
+    next->next_free = heap->unused_nodes;
+    heap->unused_nodes = next_idx;
+}
+
+static void add_heap_block(Graphics *gfx, GraphicsHeap *heap, VkDeviceSize size) {
+    if (heap->blocks.count == HEAP_MAX_BLOCKS)
+        CTK_FATAL("cannot add %u byte heap block: already at max heap block count of %u", size, HEAP_MAX_BLOCKS);
 
-    auto mem = allocate<GraphicsMemory>(gfx->mem.perm, 1);
-    mem->buffer = stack->mem->buffer;
-    mem->offset = align_offset;
+    BufferInfo buffer_info = heap->buffer_info;
+    buffer_info.size = size;
+
+    HeapBlock *block = push(&heap->blocks);
+    block->buffer = create_buffer(allocate<Buffer>(gfx->mem.perm, 1), gfx->device, gfx->physical_device, buffer_info);
+    block->size = size;
+
+    // Host memory is coherent, so it's mapped once and written directly without flushing.
+    block->mapped = heap->type == GraphicsMemory::Type::HOST ? (u8 *)map_buffer(gfx->device, block->buffer) : NULL;
+
+    u32 node_idx = take_node(heap);
+    HeapNode *node = heap->nodes + node_idx;
+    node->offset = 0;
+    node->size = size;
+    node->block = heap->blocks.count - 1;
+    node->prev_range = HEAP_NULL_NODE;
+    node->next_range = HEAP_NULL_NODE;
+    insert_free_node(heap, node_idx);
+}
+
+// buffer_info.size is the size of each block of buffer memory the heap allocates from.
+static GraphicsHeap *create_graphics_heap(Graphics *gfx, BufferInfo buffer_info) {
+    auto heap = allocate<GraphicsHeap>(gfx->mem.perm, 1);
+    heap->buffer_info = buffer_info;
+    heap->type = (buffer_info.mem_property_flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ==
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                 ? GraphicsMemory::Type::DEVICE
+                 : GraphicsMemory::Type::HOST;
+    heap->blocks = {};
+    heap->nodes = allocate<HeapNode>(gfx->mem.perm, HEAP_MAX_NODES);
+    heap->handles = allocate<GraphicsMemory>(gfx->mem.perm, HEAP_MAX_NODES);
+    heap->node_count = 0;
+    heap->unused_nodes = HEAP_NULL_NODE;
+    heap->fl_bitmap = 0;
+    heap->allocation_count = 0;
+    heap->allocated_bytes = 0;
+
+    for (u32 fl = 0; fl < HEAP_FL_COUNT; ++fl) {
+        heap->sl_bitmaps[fl] = 0;
+        for (u32 sl = 0; sl < HEAP_SL_COUNT; ++sl)
+            heap->free_lists[fl][sl] = HEAP_NULL_NODE;
+    }
+
+    add_heap_block(gfx, heap, buffer_info.size);
+
+    return heap;
+}
+
+static GraphicsMemory *allocate(Graphics *gfx, GraphicsHeap *heap, VkDeviceSize size, VkDeviceSize align) {
+    CTK_ASSERT(align > 0 && (align & (align - 1)) == 0);
+    align = max(align, HEAP_MIN_ALLOCATION);
+
+    // Ranges start HEAP_MIN_ALLOCATION aligned, so any range of search_size bytes fits an aligned allocation.
+    VkDeviceSize alloc_size = max(size + ((0 - size) & (HEAP_MIN_ALLOCATION - 1)), HEAP_MIN_ALLOCATION);
+    VkDeviceSize search_size = alloc_size + align - HEAP_MIN_ALLOCATION;
+
+    u32 node_idx = find_free_node(heap, search_size);
+    if (node_idx == HEAP_NULL_NODE) {
+        // Allocations larger than a block get a block of their own.
+        add_heap_block(gfx, heap, max(heap->buffer_info.size, round_to_size_class(search_size)));
+        node_idx = find_free_node(heap, search_size);
+        CTK_ASSERT(node_idx != HEAP_NULL_NODE);
+    }
+
+    remove_free_node(heap, node_idx);
+
+    // Padding before the aligned offset and space after the allocation are returned to the free lists. Neither has a
+    // free neighbour to merge with, since free ranges are never adjacent.
+    VkDeviceSize align_overflow = heap->nodes[node_idx].offset % align;
+    if (align_overflow != 0) {
+        u32 aligned_idx = split_node(heap, node_idx, align - align_overflow);
+        insert_free_node(heap, node_idx);
+        node_idx = aligned_idx;
+    }
+
+    if (heap->nodes[node_idx].size > alloc_size)
+        insert_free_node(heap, split_node(heap, node_idx, alloc_size));
+
+    HeapNode *node = heap->nodes + node_idx;
+    HeapBlock *block = heap->blocks.data + node->block;
+    node->in_use = true;
+    heap->allocated_bytes += node->size;
+    ++heap->allocation_count;
+
+    GraphicsMemory *mem = heap->handles + node_idx;
+    mem->buffer = block->buffer;
+    mem->offset = node->offset;
     mem->size = size;
-    mem->type = stack->mem->type;
+    mem->mapped = block->mapped != NULL ? block->mapped + node->offset : NULL;
+    mem->type = heap->type;
+    mem->heap = heap;
     return mem;
 }
 
+// Returns mem's range to its heap. mem's handle is recycled, so it must not be used afterwards. Freeing a handle twice
+// is caught unless its node has been allocated again in between.
+static void free_graphics_memory(GraphicsMemory *mem) {
+    GraphicsHeap *heap = mem->heap;
+    u32 node_idx = (u32)(mem - heap->handles);
+    if (node_idx >= heap->node_count || !heap->nodes[node_idx].in_use)
+        CTK_FATAL("cannot free graphics memory: heap node %u is not allocated", node_idx);
+
+    heap->nodes[node_idx].in_use = false;
+    heap->allocated_bytes -= heap->nodes[node_idx].size;
+    --heap->allocation_count;
+
+    u32 next_idx = heap->nodes[node_idx].next_range;
+    if (next_idx != HEAP_NULL_NODE && heap->nodes[next_idx].free) {
+        remove_free_node(heap, next_idx);
+        merge_next_node(heap, node_idx);
+    }
+
+    u32 prev_idx = heap->nodes[node_idx].prev_range;
+    if (prev_idx != HEAP_NULL_NODE && heap->nodes[prev_idx].free) {
+        remove_free_node(heap, prev_idx);
+        merge_next_node(heap, prev_idx);
+        node_idx = prev_idx;
+    }
+
+    insert_free_node(heap, node_idx);
+}
+
+static GraphicsHeapStats get_heap_stats(GraphicsHeap *heap) {
+    GraphicsHeapStats stats = {};
+    stats.block_count = heap->blocks.count;
+    stats.allocation_count = heap->allocation_count;
+    stats.allocated_bytes = heap->allocated_bytes;
+
+    for (u32 i = 0; i < heap->blocks.count; ++i)
+        stats.block_bytes += heap->blocks.data[i].size;
+
+    for (u32 fl = 0; fl < HEAP_FL_COUNT; ++fl) {
+        for (u32 sl = 0; sl < HEAP_SL_COUNT; ++sl) {
+            for (u32 node_idx = heap->free_lists[fl][sl]; node_idx != HEAP_NULL_NODE;
+                 node_idx = heap->nodes[node_idx].next_free)
+            {
+                VkDeviceSize size = heap->nodes[node_idx].size;
+                ++stats.free_range_count;
+                stats.free_bytes += size;
+                stats.largest_free_range = max(stats.largest_free_range, size);
+            }
+        }
+    }
+
+    stats.fragmentation = stats.free_bytes > 0 ? 1.0f - ((f32)stats.largest_free_range / stats.free_bytes) : 0.0f;
+    return stats;
+}
+
+static void print_heap_stats(cstr name, GraphicsHeap *heap) {
+    GraphicsHeapStats stats = get_heap_stats(heap);
+    print_line("%s heap: %u blocks (%llu bytes), %u allocations (%llu bytes), %u free ranges (%llu bytes, largest "
+               "%llu), fragmentation %.3f",
+               name, stats.block_count, (u64)stats.block_bytes, stats.allocation_count, (u64)stats.allocated_bytes,
+               stats.free_range_count, (u64)stats.free_bytes, (u64)stats.largest_free_range, stats.fragmentation);
+}
+
+static StagingRing *create_staging_ring(Graphics *gfx, GraphicsHeap *heap, VkDeviceSize size) {
+    auto ring = allocate<StagingRing>(gfx->mem.perm, 1);
+    ring->mem = allocate(gfx, heap, size, 16);
+    ring->head = 0;
+    ring->tail = 0;
+    return ring;
+}
+
+// Reserves size bytes of staging for uploads recorded this frame and returns a pointer to write them in place. offset
+// is set to their offset in the staging buffer, for use as a copy source.
+static u8 *allocate_staging(Graphics *gfx, VkDeviceSize size, VkDeviceSize align, VkDeviceSize *offset) {
+    StagingRing *ring = gfx->gfx_mem.staging;
+
+    // An empty ring restarts at 0, so any allocation that fits in the ring succeeds. Frames in flight all recorded
+    // their staging end at head while it is empty, so they move back to 0 with it.
+    if (ring->head == ring->tail && ring->head != 0) {
+        for (u32 i = 0; i < gfx->sync.frames->count; ++i) {
+            Frame *frame = gfx->sync.frames->data + i;
+            if (frame->staging_end == ring->head)
+                frame->staging_end = 0;
+        }
+
+        ring->head = 0;
+        ring->tail = 0;
+    }
+
+    VkDeviceSize align_overflow = ring->head % align;
+    VkDeviceSize start = ring->head + (align_overflow ? align - align_overflow : 0);
+
+    // Free space is [head, size) and [0, tail) while head is ahead of tail, or [head, tail) once it has wrapped.
+    if (ring->head >= ring->tail) {
+        if (start + size > ring->mem->size) {
+            if (size >= ring->tail) {
+                CTK_FATAL("allocating %u bytes of staging would overflow staging ring (head=%u, tail=%u, size=%u)",
+                          size, ring->head, ring->tail, ring->mem->size);
+            }
+
+            start = 0;
+        }
+    }
+    else if (start + size >= ring->tail) {
+        CTK_FATAL("allocating %u bytes of staging would overflow staging ring (head=%u, tail=%u, size=%u)",
+                  size, ring->head, ring->tail, ring->mem->size);
+    }
+
+    ring->head = start + size;
+    *offset = ring->mem->offset + start;
+    return ring->mem->mapped + start;
+}
+
+// Copies size bytes to staging and returns their offset in the staging buffer.
+static VkDeviceSize push_staging(Graphics *gfx, void *data, VkDeviceSize size, VkDeviceSize align) {
+    VkDeviceSize offset = 0;
+    memcpy(allocate_staging(gfx, size, align, &offset), data, size);
+    return offset;
+}
+
+static bool has_transfer_queue(Graphics *gfx) {
+    return gfx->physical_device->queue_family_idxs.transfer != U32_MAX;
+}
+
+static void create_uploads(Graphics *gfx) {
+    VkCommandBuffer graphics_cmd_bufs[MAX_UPLOADS];
+    allocate_cmd_bufs(gfx->device, gfx->main_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, graphics_cmd_bufs,
+                      MAX_UPLOADS);
+
+    // Without a transfer queue, transfer uploads are recorded into the graphics command buffers instead.
+    VkCommandBuffer transfer_cmd_bufs[MAX_UPLOADS];
+    if (has_transfer_queue(gfx)) {
+        allocate_cmd_bufs(gfx->device, gfx->transfer_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, transfer_cmd_bufs,
+                          MAX_UPLOADS);
+    }
+    else {
+        memcpy(transfer_cmd_bufs, graphics_cmd_bufs, sizeof(transfer_cmd_bufs));
+    }
+
+    for (u32 i = 0; i < MAX_UPLOADS; ++i) {
+        gfx->upload.uploads[i] = {
+            .graphics_cmd_buf = graphics_cmd_bufs[i],
+            .transfer_cmd_buf = transfer_cmd_bufs[i],
+            .cmd_buf = VK_NULL_HANDLE,
+            .transfer = false,
+            .release_count = 0,
+            .fence = create_fence(gfx->device),
+            .finished = create_semaphore(gfx->device),
+        };
+    }
+
+    gfx->upload.next = 0;
+    gfx->upload.current = NULL;
+    gfx->upload.pending = VK_NULL_HANDLE;
+    gfx->upload.acquires = {};
+}
+
+// Begins recording an upload into the least recently submitted upload command buffer, which write() also records
+// device copies into until submit_upload().
+static VkCommandBuffer begin_upload(Graphics *gfx, UploadQueue queue) {
+    CTK_ASSERT(gfx->upload.current == NULL);
+
+    Upload *upload = gfx->upload.uploads + gfx->upload.next;
+    gfx->upload.next = (gfx->upload.next + 1) % MAX_UPLOADS;
+
+    // Usually signalled long ago, since MAX_UPLOADS - 1 uploads have been submitted since.
+    validate(vkWaitForFences(gfx->device, 1, &upload->fence, VK_TRUE, U64_MAX), "vkWaitForFences failed");
+    validate(vkResetFences(gfx->device, 1, &upload->fence), "vkResetFences failed");
+
+    // Each transfer upload reserves room for the acquires of its releases. Once too many acquires are waiting on the
+    // next frame, uploads go to the graphics queue instead, which needs none.
+    upload->transfer = queue == UploadQueue::TRANSFER && has_transfer_queue(gfx) &&
+                       gfx->upload.acquires.count + MAX_UPLOAD_RELEASES <= MAX_OWNERSHIP_ACQUIRES;
+    upload->release_count = 0;
+    upload->cmd_buf = upload->transfer ? upload->transfer_cmd_buf : upload->graphics_cmd_buf;
+
+    gfx->upload.current = upload;
+    begin_temp_cmd_buf(upload->cmd_buf);
+    return upload->cmd_buf;
+}
+
+// Submits the upload being recorded without waiting for it to execute.
+static void submit_upload(Graphics *gfx) {
+    Upload *upload = gfx->upload.current;
+    CTK_ASSERT(upload != NULL);
+    validate(vkEndCommandBuffer(upload->cmd_buf), "failed to end upload command buffer");
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount = gfx->upload.pending != VK_NULL_HANDLE ? 1 : 0;
+    submit_info.pWaitSemaphores = &gfx->upload.pending;
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &upload->cmd_buf;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &upload->finished;
+    VkQueue queue = upload->transfer ? gfx->queue.transfer : gfx->queue.graphics;
+    validate(vkQueueSubmit(queue, 1, &submit_info, upload->fence), "failed to submit upload");
+
+    gfx->upload.pending = upload->finished;
+    gfx->upload.current = NULL;
+}
+
 template<typename Type>
-static GraphicsArray<Type> *create_graphics_array(Graphics *gfx, GraphicsStack *stack, VkDeviceSize size,
-                                                  VkDeviceSize align)
+static void allocate_graphics_array(Graphics *gfx, GraphicsArray<Type> *array, GraphicsHeap *heap, VkDeviceSize size,
+                                    VkDeviceSize align)
 {
-    auto array = allocate<GraphicsArray<Type>>(gfx->mem.perm, 1);
-    array->mem = allocate(gfx, stack, size * sizeof(Type), align);
+    array->mem = allocate(gfx, heap, size * sizeof(Type), align);
     array->count = 0;
     array->size = size;
+}
+
+template<typename Type>
+static GraphicsArray<Type> *create_graphics_array(Graphics *gfx, GraphicsHeap *heap, VkDeviceSize size,
+                                                  VkDeviceSize align)
+{
+    auto array = allocate<GraphicsArray<Type>>(gfx->mem.perm, 1);
+    allocate_graphics_array(gfx, array, heap, size, align);
     return array;
 }
 
+// Returns array's memory to its heap. The array itself can be given new memory with allocate_graphics_array().
+template<typename Type>
+static void free_graphics_array(GraphicsArray<Type> *array) {
+    free_graphics_memory(array->mem);
+    array->mem = NULL;
+    array->count = 0;
+    array->size = 0;
+}
+
 template<typename Type>
 static VkDeviceSize count_offset(GraphicsArray<Type> *array) {
     return array->mem->offset + (array->count * sizeof(Type));
 }
 
 template<typename Type>
-static VkDeviceSize push(Graphics *gfx, GraphicsArray<Type> *array, void *data, VkDeviceSize count) {
-    if (array->count + count > array->size)
-        CTK_FATAL("pushing %u elements to array would overflow by %u", count, array->count + count - array->size);
+static VkDeviceSize push(Graphics *gfx, GraphicsArray<Type> *array, void *data, VkDeviceSize count);
+
+template<typename Type>
+static void write(Graphics *gfx, GraphicsArray<Type> *array, VkDeviceSize index, void *data, VkDeviceSize count) {
+    if (index + count > array->size)
+        CTK_FATAL("writing %u elements at index %u would overflow array by %u", count, index, index + count - array->size);
 
     VkDeviceSize data_byte_count = count * sizeof(Type);
+    VkDeviceSize data_offset = array->mem->offset + (index * sizeof(Type));
 
     if (array->mem->type == GraphicsMemory::Type::HOST) {
-        write_to_buffer(gfx->device, {
-            .buffer = array->mem->buffer,
-            .offset = count_offset(array),
-            .data = data,
-            .size = data_byte_count,
-        });
+        memcpy(array->mem->mapped + (index * sizeof(Type)), data, data_byte_count);
     }
     else {
-        VkDeviceSize staging_offset = push(gfx, gfx->gfx_mem.staging, data, data_byte_count);
-        copy_to_buffer(gfx->device, gfx->temp_cmd_buf, {
+        Upload *upload = gfx->upload.current;
+        CTK_ASSERT(upload != NULL);
+
+        // Host memory, staging included, is shared concurrently by the graphics and transfer families, so either queue
+        // can read it without an ownership transfer.
+        VkDeviceSize staging_offset = push_staging(gfx, data, data_byte_count, 4);
+        copy_to_buffer(gfx->device, upload->cmd_buf, {
             .src_buffer = gfx->gfx_mem.staging->mem->buffer,
             .src_offset = staging_offset,
             .dst_buffer = array->mem->buffer,
-            .dst_offset = count_offset(array),
+            .dst_offset = data_offset,
             .size = data_byte_count,
         });
+
+        // Release written range to the graphics queue family, which acquires it with a matching barrier next frame.
+        if (upload->transfer) {
+            if (upload->release_count == MAX_UPLOAD_RELEASES)
+                CTK_FATAL("cannot release buffer range: already at max upload release count of %u",
+                          MAX_UPLOAD_RELEASES);
+
+            ++upload->release_count;
+
+            BufferMemoryBarrier ownership_transfer = {
+                .src = {
+                    .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .queue_family_index = gfx->physical_device->queue_family_idxs.transfer,
+                },
+                .dst = {
+                    .stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    .access = 0,
+                    .queue_family_index = gfx->physical_device->queue_family_idxs.graphics,
+                },
+                .offset = data_offset,
+                .size = data_byte_count,
+            };
+            buffer_memory_barrier(upload->cmd_buf, array->mem->buffer, ownership_transfer);
+
+            ownership_transfer.src.access = 0;
+            ownership_transfer.dst.access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                            VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            push(&gfx->upload.acquires, create_buffer_memory_barrier(array->mem->buffer, ownership_transfer));
+        }
     }
+}
+
+template<typename Type>
+static VkDeviceSize push(Graphics *gfx, GraphicsArray<Type> *array, void *data, VkDeviceSize count) {
+    if (array->count + count > array->size)
+        CTK_FATAL("pushing %u elements to array would overflow by %u", count, array->count + count - array->size);
+
+    write(gfx, array, array->count, data, count);
 
     // Starting index of data is returned.
     VkDeviceSize data_start = array->count;
@@ -280,29 +1020,126 @@ static void clear(GraphicsArray<Type> *array) {
     array->count = 0;
 }
 
+// Pointer to a HOST array's element at index, for writing in place instead of through write() or push().
+template<typename Type>
+static Type *get_mapped(GraphicsArray<Type> *array, VkDeviceSize index) {
+    CTK_ASSERT(array->mem->type == GraphicsMemory::Type::HOST);
+    CTK_ASSERT(index <= array->size);
+    return (Type *)array->mem->mapped + index;
+}
+
+static bool allocate_range(Array<MeshRange> *free_ranges, u32 count, MeshRange *range) {
+    // Empty ranges take no space, even from a full block.
+    if (count == 0) {
+        *range = {};
+        return true;
+    }
+
+    // First-fit search of free ranges.
+    for (u32 i = 0; i < free_ranges->count; ++i) {
+        MeshRange *free_range = free_ranges->data + i;
+
+        if (free_range->count < count)
+            continue;
+
+        range->offset = free_range->offset;
+        range->count = count;
+        free_range->offset += count;
+        free_range->count -= count;
+
+        // Remove exhausted free range, preserving offset order.
+        if (free_range->count == 0) {
+            for (u32 j = i + 1; j < free_ranges->count; ++j)
+                free_ranges->data[j - 1] = free_ranges->data[j];
+
+            --free_ranges->count;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static void free_range(Array<MeshRange> *free_ranges, MeshRange range) {
+    if (range.count == 0)
+        return;
+
+    // Find first free range after freed range.
+    u32 next = 0;
+    while (next < free_ranges->count && free_ranges->data[next].offset < range.offset)
+        ++next;
+
+    bool merge_prev = next > 0 &&
+                      free_ranges->data[next - 1].offset + free_ranges->data[next - 1].count == range.offset;
+    bool merge_next = next < free_ranges->count &&
+                      range.offset + range.count == free_ranges->data[next].offset;
+
+    if (merge_prev && merge_next) {
+        // Freed range bridges prev and next; fold next into prev and remove it.
+        free_ranges->data[next - 1].count += range.count + free_ranges->data[next].count;
+
+        for (u32 i = next + 1; i < free_ranges->count; ++i)
+            free_ranges->data[i - 1] = free_ranges->data[i];
+
+        --free_ranges->count;
+    }
+    else if (merge_prev) {
+        free_ranges->data[next - 1].count += range.count;
+    }
+    else if (merge_next) {
+        free_ranges->data[next].offset = range.offset;
+        free_ranges->data[next].count += range.count;
+    }
+    else {
+        if (free_ranges->count == free_ranges->size)
+            CTK_FATAL("cannot free range: free range list is full (size=%u)", free_ranges->size);
+
+        for (u32 i = free_ranges->count; i > next; --i)
+            free_ranges->data[i] = free_ranges->data[i - 1];
+
+        free_ranges->data[next] = range;
+        ++free_ranges->count;
+    }
+}
+
 static void create_graphics_memory(Graphics *gfx) {
-    gfx->gfx_mem.host = create_graphics_stack(gfx, {
+    BufferInfo host_buffer_info = {
         .size = megabyte(256),
         .sharing_mode = VK_SHARING_MODE_EXCLUSIVE,
         .usage_flags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                        // VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
                        // VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         .mem_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    });
+    };
+
+    // Staging in host memory is read by graphics queue copies (display, palette) and by transfer queue mesh uploads.
+    // Exclusive buffers would need an ownership transfer between them, so host memory is shared concurrently instead.
+    if (has_transfer_queue(gfx)) {
+        host_buffer_info.sharing_mode = VK_SHARING_MODE_CONCURRENT;
+        host_buffer_info.queue_family_idxs[0] = gfx->physical_device->queue_family_idxs.graphics;
+        host_buffer_info.queue_family_idxs[1] = gfx->physical_device->queue_family_idxs.transfer;
+        host_buffer_info.queue_family_idx_count = 2;
+    }
 
-    gfx->gfx_mem.device = create_graphics_stack(gfx, {
-        .size = megabyte(512),
+    gfx->gfx_mem.host = create_graphics_heap(gfx, host_buffer_info);
+
+    gfx->gfx_mem.device = create_graphics_heap(gfx, {
+        .size = megabyte(128),
         .sharing_mode = VK_SHARING_MODE_EXCLUSIVE,
         .usage_flags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         .mem_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
     });
 
-    gfx->gfx_mem.staging = create_graphics_array<u8>(gfx, gfx->gfx_mem.host, megabyte(128), 1);
+    gfx->gfx_mem.staging = create_staging_ring(gfx, gfx->gfx_mem.host, megabyte(128));
 }
 
 static void create_render_passes(Graphics *gfx) {
@@ -382,13 +1219,27 @@ static void create_framebuffers(Graphics *gfx) {
 }
 
 static void create_primary_render_cmd_bufs(Graphics *gfx) {
-    gfx->primary_render_cmd_bufs = create_array_full<VkCommandBuffer>(gfx->mem.perm, gfx->swapchain->image_count);
+    gfx->primary_render_cmd_bufs = create_array_full<VkCommandBuffer>(gfx->mem.perm, MAX_FRAMES_IN_FLIGHT);
     allocate_cmd_bufs(gfx->device, gfx->main_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
                       gfx->primary_render_cmd_bufs->data, gfx->primary_render_cmd_bufs->count);
 }
 
+static void create_render_threads(Graphics *gfx) {
+    gfx->render_thread_count = min(worker_thread_count(), MAX_RENDER_THREADS);
+
+    for (u32 frame_idx = 0; frame_idx < MAX_FRAMES_IN_FLIGHT; ++frame_idx) {
+        for (u32 i = 0; i < gfx->render_thread_count; ++i) {
+            RenderThread *render_thread = &gfx->render_threads[frame_idx][i];
+            render_thread->cmd_pool = create_cmd_pool(gfx->device, gfx->physical_device->queue_family_idxs.graphics);
+            allocate_cmd_bufs(gfx->device, render_thread->cmd_pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                              &render_thread->cmd_buf, 1);
+        }
+    }
+}
+
 static void init_sync(Graphics *gfx, u32 frame_count) {
     gfx->sync.frame_idx = U32_MAX;
+    gfx->sync.frame = NULL;
     gfx->sync.frames = create_array<Frame>(gfx->mem.perm, frame_count);
 
     for (u32 i = 0; i < frame_count; ++i) {
@@ -396,6 +1247,7 @@ static void init_sync(Graphics *gfx, u32 frame_count) {
             .img_aquired = create_semaphore(gfx->device),
             .render_finished = create_semaphore(gfx->device),
             .in_flight = create_fence(gfx->device),
+            .staging_end = 0,
         });
     }
 }
@@ -406,14 +1258,28 @@ static void create_vulkan_state(Graphics *gfx, Window *window) {
     gfx->surface = create_win32_surface(gfx->instance, window->handle, window->instance);
 
     // Devices
-    auto requested_feature = PhysicalDeviceFeature::geometryShader;
+    // Cull pass draw commands start at each draw's own instance range, so drawIndirectFirstInstance is required.
+    // multiDrawIndirect is last, as it is only enabled if supported.
+    PhysicalDeviceFeature requested_features[] = {
+        PhysicalDeviceFeature::geometryShader,
+        PhysicalDeviceFeature::drawIndirectFirstInstance,
+        PhysicalDeviceFeature::multiDrawIndirect,
+    };
+    u32 required_feature_count = CTK_ARRAY_SIZE(requested_features) - 1;
     gfx->physical_device = create_physical_device(*gfx->mem.temp, allocate<PhysicalDevice>(gfx->mem.perm, 1),
-                                                  gfx->instance, gfx->surface, &requested_feature, 1);
-    gfx->device = create_device(gfx->physical_device, &requested_feature, 1);
+                                                  gfx->instance, gfx->surface, requested_features,
+                                                  required_feature_count);
+    gfx->multi_draw_indirect = physical_device_feature_supported(PhysicalDeviceFeature::multiDrawIndirect,
+                                                                 &gfx->physical_device->features);
+    gfx->device = create_device(gfx->physical_device, requested_features,
+                                gfx->multi_draw_indirect ? required_feature_count + 1 : required_feature_count);
 
     // Queues
     gfx->queue.graphics = get_queue(gfx->device, gfx->physical_device->queue_family_idxs.graphics, 0);
     gfx->queue.present = get_queue(gfx->device, gfx->physical_device->queue_family_idxs.present, 0);
+    gfx->queue.transfer = has_transfer_queue(gfx)
+                          ? get_queue(gfx->device, gfx->physical_device->queue_family_idxs.transfer, 0)
+                          : gfx->queue.graphics;
 
     // Swapchain
     gfx->swapchain = create_swapchain(*gfx->mem.temp, allocate<Swapchain>(gfx->mem.perm, 1), gfx->device,
@@ -421,18 +1287,76 @@ static void create_vulkan_state(Graphics *gfx, Window *window) {
 
     // Command State
     gfx->main_cmd_pool = create_cmd_pool(gfx->device, gfx->physical_device->queue_family_idxs.graphics);
-    allocate_cmd_bufs(gfx->device, gfx->main_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &gfx->temp_cmd_buf, 1);
+    gfx->transfer_cmd_pool = has_transfer_queue(gfx)
+                             ? create_cmd_pool(gfx->device, gfx->physical_device->queue_family_idxs.transfer)
+                             : VK_NULL_HANDLE;
+    create_uploads(gfx);
 
     create_graphics_memory(gfx);
     create_render_passes(gfx);
     create_framebuffers(gfx);
     create_primary_render_cmd_bufs(gfx);
-    init_sync(gfx, 2);
+    create_render_threads(gfx);
+    init_sync(gfx, MAX_FRAMES_IN_FLIGHT);
+}
+
+template<typename VertexType>
+static bool mesh_block_released(MeshBlock<VertexType> *block) {
+    return block->vertexes->mem == NULL;
+}
+
+template<typename VertexType>
+static MeshBlock<VertexType> *push_mesh_block(Graphics *gfx, MeshArena<VertexType> *arena, u32 vertex_count,
+                                              u32 index_count)
+{
+    MeshBlock<VertexType> *block = NULL;
+    for (u32 i = 0; i < arena->blocks.count; ++i) {
+        if (mesh_block_released(arena->blocks.data + i)) {
+            block = arena->blocks.data + i;
+            break;
+        }
+    }
+
+    if (block != NULL) {
+        allocate_graphics_array(gfx, block->vertexes, gfx->gfx_mem.device, vertex_count, 16);
+        allocate_graphics_array(gfx, block->indexes, gfx->gfx_mem.device, index_count, 16);
+        block->free_vertex_ranges->count = 0;
+        block->free_index_ranges->count = 0;
+    }
+    else {
+        if (arena->blocks.count == MAX_MESH_BLOCKS)
+            CTK_FATAL("cannot push mesh block: already at max mesh block count of %u", MAX_MESH_BLOCKS);
+
+        block = push(&arena->blocks);
+        block->vertexes = create_graphics_array<VertexType>(gfx, gfx->gfx_mem.device, vertex_count, 16);
+        block->indexes = create_graphics_array<u32>(gfx, gfx->gfx_mem.device, index_count, 16);
+        block->free_vertex_ranges = create_array<MeshRange>(gfx->mem.perm, MAX_FREE_MESH_RANGES);
+        block->free_index_ranges = create_array<MeshRange>(gfx->mem.perm, MAX_FREE_MESH_RANGES);
+    }
+
+    // Entire block starts as a single free range.
+    push(block->free_vertex_ranges, { .offset = 0, .count = vertex_count });
+    push(block->free_index_ranges, { .offset = 0, .count = index_count });
+
+    // Arena allocates ranges within the arrays rather than pushing, so mark them full.
+    block->vertexes->count = vertex_count;
+    block->indexes->count = index_count;
+
+    return block;
+}
+
+template<typename VertexType>
+static void init_mesh_arena(Graphics *gfx, MeshArena<VertexType> *arena, u32 block_vertex_count,
+                            u32 block_index_count)
+{
+    arena->block_vertex_count = block_vertex_count;
+    arena->block_index_count = block_index_count;
+    push_mesh_block(gfx, arena, block_vertex_count, block_index_count);
 }
 
 static void create_mesh_data(Graphics *gfx) {
-    gfx->mesh_data.vertexes = create_graphics_array<Vertex>(gfx, gfx->gfx_mem.device, 1024, 16);
-    gfx->mesh_data.indexes = create_graphics_array<u32>(gfx, gfx->gfx_mem.device, 4096, 16);
+    init_mesh_arena(gfx, &gfx->mesh_data, 65536, 262144);
+    init_mesh_arena(gfx, &gfx->terrain_mesh_data, 65536, 393216);
 }
 
 static Shader *create_shader(Graphics *gfx, cstr spirv_path, VkShaderStageFlagBits stage) {
@@ -464,11 +1388,16 @@ static void create_shaders(Graphics *gfx) {
 
     gfx->shader.texture.vert = create_shader(gfx, "shaders/texture.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
     gfx->shader.texture.frag = create_shader(gfx, "shaders/texture.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    gfx->shader.terrain.vert = create_shader(gfx, "shaders/terrain.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+    gfx->shader.terrain.frag = create_shader(gfx, "shaders/terrain.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    gfx->shader.cull = create_shader(gfx, "shaders/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 }
 
 static void transition_image_layout(Graphics *gfx, Image *image, VkImageLayout src, VkImageLayout dst) {
-    begin_temp_cmd_buf(gfx->temp_cmd_buf);
-        image_memory_barrier(gfx->temp_cmd_buf, image, {
+    VkCommandBuffer cmd_buf = begin_upload(gfx, UploadQueue::GRAPHICS);
+        image_memory_barrier(cmd_buf, image, {
             .src = {
                 .layout = src,
                 .stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
@@ -489,19 +1418,69 @@ static void transition_image_layout(Graphics *gfx, Image *image, VkImageLayout s
                 .layerCount = 1,
             },
         });
-    submit_temp_cmd_buf(gfx->temp_cmd_buf, gfx->queue.graphics);
-}
+    submit_upload(gfx);
+}
+
+static void create_images(Graphics *gfx) {
+    VkFormat display_format = DISPLAY_VK_FORMATS[(u32)gfx->display_format];
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        gfx->image.display[i] = create_image(allocate<Image>(gfx->mem.perm, 1), gfx->device, gfx->physical_device, {
+            .image = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .flags = 0,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = display_format,
+                .extent = {
+                    .width = gfx->swapchain->extent.width,
+                    .height = gfx->swapchain->extent.height,
+                    .depth = 1,
+                },
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount = 0, // Ignored if sharingMode is not VK_SHARING_MODE_CONCURRENT.
+                .pQueueFamilyIndices = NULL, // Ignored if sharingMode is not VK_SHARING_MODE_CONCURRENT.
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            },
+            .view = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .flags = 0,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = display_format,
+                .components = {
+                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+                },
+                .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            },
+            .mem_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        });
 
-static void create_images(Graphics *gfx) {
-    gfx->image.display = create_image(allocate<Image>(gfx->mem.perm, 1), gfx->device, gfx->physical_device, {
+        transition_image_layout(gfx, gfx->image.display[i], VK_IMAGE_LAYOUT_UNDEFINED,
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    gfx->image.palette = create_image(allocate<Image>(gfx->mem.perm, 1), gfx->device, gfx->physical_device, {
         .image = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
             .flags = 0,
-            .imageType = VK_IMAGE_TYPE_2D,
+            .imageType = VK_IMAGE_TYPE_1D,
             .format = VK_FORMAT_R8G8B8A8_UNORM,
             .extent = {
-                .width = gfx->swapchain->extent.width,
-                .height = gfx->swapchain->extent.height,
+                .width = DISPLAY_PALETTE_SIZE,
+                .height = 1,
                 .depth = 1,
             },
             .mipLevels = 1,
@@ -517,7 +1496,7 @@ static void create_images(Graphics *gfx) {
         .view = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             .flags = 0,
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .viewType = VK_IMAGE_VIEW_TYPE_1D,
             .format = VK_FORMAT_R8G8B8A8_UNORM,
             .components = {
                 .r = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -536,10 +1515,44 @@ static void create_images(Graphics *gfx) {
         .mem_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
     });
 
-    transition_image_layout(gfx, gfx->image.display, VK_IMAGE_LAYOUT_UNDEFINED,
+    transition_image_layout(gfx, gfx->image.palette, VK_IMAGE_LAYOUT_UNDEFINED,
                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
+// Writes DISPLAY_PALETTE_SIZE RGBA8 colors to the display palette.
+static void write_display_palette(Graphics *gfx, u32 *colors) {
+    VkDeviceSize staging_offset = push_staging(gfx, colors, DISPLAY_PALETTE_SIZE * sizeof(u32), 4);
+
+    VkBufferImageCopy copy = {
+        .bufferOffset = staging_offset,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { DISPLAY_PALETTE_SIZE, 1, 1 },
+    };
+
+    VkCommandBuffer cmd_buf = begin_upload(gfx, UploadQueue::GRAPHICS);
+        copy_regions_to_image(cmd_buf, gfx->gfx_mem.staging->mem->buffer, gfx->image.palette, &copy, 1);
+    submit_upload(gfx);
+}
+
+// Grayscale ramp, so single-channel displays look the same as shades written to an RGBA8 display.
+static void create_display_palette(Graphics *gfx) {
+    u32 colors[DISPLAY_PALETTE_SIZE];
+    for (u32 i = 0; i < DISPLAY_PALETTE_SIZE; ++i) {
+        u32 shade = (i * 255) / (DISPLAY_PALETTE_SIZE - 1);
+        colors[i] = 0xFF000000 | (shade << 16) | (shade << 8) | shade;
+    }
+
+    write_display_palette(gfx, colors);
+}
+
 static void create_samplers(Graphics *gfx) {
     gfx->sampler.nearest = create_sampler(gfx->device, {
         .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -559,6 +1572,26 @@ static void create_samplers(Graphics *gfx) {
         .borderColor = VK_BORDER_COLOR_INT_OPAQUE_WHITE,
         .unnormalizedCoordinates = VK_FALSE,
     });
+
+    // Palette lookups blend between neighbouring entries and clamp values outside [0, 1].
+    gfx->sampler.palette = create_sampler(gfx->device, {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 16,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_NEVER,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_INT_OPAQUE_WHITE,
+        .unnormalizedCoordinates = VK_FALSE,
+    });
 }
 
 static DescriptorSet *create_descriptor_set(Graphics *gfx, u32 handle_count, DescriptorInfo *descriptor_infos,
@@ -576,37 +1609,149 @@ static DescriptorSet *create_descriptor_set(Graphics *gfx, u32 handle_count, Des
     return ds;
 }
 
+static void create_instance_data(Graphics *gfx) {
+    // 256 is the largest minStorageBufferOffsetAlignment allowed.
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        gfx->cull_entities[i] = create_graphics_array<CullEntity>(gfx, gfx->gfx_mem.host, MAX_INSTANCES, 256);
+        gfx->draw_commands[i] =
+            create_graphics_array<VkDrawIndexedIndirectCommand>(gfx, gfx->gfx_mem.device, MAX_CULL_DRAWS, 256);
+        gfx->instance_matrixes[i] = create_graphics_array<Matrix>(gfx, gfx->gfx_mem.device, MAX_INSTANCES, 256);
+    }
+}
+
+static VkDescriptorBufferInfo create_buffer_info(GraphicsMemory *mem) {
+    return { mem->buffer->handle, mem->offset, mem->size };
+}
+
 static void create_descriptor_sets(Graphics *gfx) {
     gfx->descriptor_pool = create_descriptor_pool(gfx->device, {
         .descriptor_count = {
             .uniform_buffer = 8,
             // .uniform_buffer_dynamic = 4,
+            .storage_buffer = 16,
             .combined_image_sampler = 8,
             // .input_attachment = 4,
         },
         .max_descriptor_sets = 64,
     });
 
+    // Instances
+    {
+        DescriptorInfo descriptor_infos[] = {
+            {
+                .count = 1,
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            },
+        };
+
+        gfx->descriptor_set.instances = create_descriptor_set(gfx, MAX_FRAMES_IN_FLIGHT, descriptor_infos,
+                                                              CTK_ARRAY_SIZE(descriptor_infos));
+
+        for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+            GraphicsMemory *instance_mem = gfx->instance_matrixes[i]->mem;
+            DescriptorBinding instance_bindings[] = {
+                {
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .buffer = {
+                        .buffer = instance_mem->buffer->handle,
+                        .offset = instance_mem->offset,
+                        .range = instance_mem->size,
+                    },
+                },
+            };
+
+            update_descriptor_set(gfx->mem.temp, gfx->device, gfx->descriptor_set.instances->handles[i],
+                                  instance_bindings, CTK_ARRAY_SIZE(instance_bindings));
+        }
+    }
+
     // Texture
     {
-        DescriptorInfo descriptor_info = {
-            .count = 1,
-            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+        DescriptorInfo descriptor_infos[] = {
+            {
+                .count = 1,
+                .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            },
+            {
+                .count = 1,
+                .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            },
         };
 
-        gfx->descriptor_set.texture = create_descriptor_set(gfx, 1, &descriptor_info, 1);
+        // One handle per frame in flight, each sampling that frame's display image.
+        gfx->descriptor_set.texture = create_descriptor_set(gfx, MAX_FRAMES_IN_FLIGHT, descriptor_infos,
+                                                            CTK_ARRAY_SIZE(descriptor_infos));
+
+        for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+            DescriptorBinding texture_bindings[] = {
+                {
+                    .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .image = {
+                        .sampler = gfx->sampler.nearest,
+                        .imageView = gfx->image.display[i]->view,
+                        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    },
+                },
+                {
+                    .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .image = {
+                        .sampler = gfx->sampler.palette,
+                        .imageView = gfx->image.palette->view,
+                        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    },
+                },
+            };
+
+            update_descriptor_set(gfx->mem.temp, gfx->device, gfx->descriptor_set.texture->handles[i],
+                                  texture_bindings, CTK_ARRAY_SIZE(texture_bindings));
+        }
+    }
 
-        DescriptorBinding texture_binding = {
-            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .image = {
-                .sampler = gfx->sampler.nearest,
-                .imageView = gfx->image.display->view,
-                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    // Cull
+    {
+        DescriptorInfo descriptor_infos[] = {
+            {
+                .count = 1,
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            },
+            {
+                .count = 1,
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            },
+            {
+                .count = 1,
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
             },
         };
 
-        update_descriptor_set(gfx->mem.temp, gfx->device, gfx->descriptor_set.texture->handles[0], &texture_binding, 1);
+        gfx->descriptor_set.cull = create_descriptor_set(gfx, MAX_FRAMES_IN_FLIGHT, descriptor_infos,
+                                                         CTK_ARRAY_SIZE(descriptor_infos));
+
+        for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+            DescriptorBinding cull_bindings[] = {
+                {
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .buffer = create_buffer_info(gfx->cull_entities[i]->mem),
+                },
+                {
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .buffer = create_buffer_info(gfx->draw_commands[i]->mem),
+                },
+                {
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .buffer = create_buffer_info(gfx->instance_matrixes[i]->mem),
+                },
+            };
+
+            update_descriptor_set(gfx->mem.temp, gfx->device, gfx->descriptor_set.cull->handles[i],
+                                  cull_bindings, CTK_ARRAY_SIZE(cull_bindings));
+        }
     }
 }
 
@@ -633,10 +1778,6 @@ static void create_descriptor_set_data(Graphics *gfx) {
     // }
 }
 
-static VkDescriptorBufferInfo create_buffer_info(GraphicsMemory *mem) {
-    return { mem->buffer->handle, mem->offset, mem->size };
-}
-
 static Pipeline *create_pipeline(Graphics *gfx, PipelineInfo *info) {
     // Shader Stages
     FixedArray<VkPipelineShaderStageCreateInfo, MAX_PIPELINE_SHADER_STAGES> shader_stages = {};
@@ -649,7 +1790,7 @@ static Pipeline *create_pipeline(Graphics *gfx, PipelineInfo *info) {
         shader_stage_info->stage = shader->stage;
         shader_stage_info->module = shader->handle;
         shader_stage_info->pName = "main";
-        shader_stage_info->pSpecializationInfo = NULL;
+        shader_stage_info->pSpecializationInfo = info->specialization;
     }
 
     VkPipelineLayoutCreateInfo layout_create_info = {};
@@ -719,6 +1860,7 @@ static Pipeline *create_pipeline(Graphics *gfx, PipelineInfo *info) {
     // Create and initialize pipeline.
     auto pipeline = allocate<Pipeline>(gfx->mem.perm, 1);
     pipeline->layout = pipeline_layout;
+    pipeline->id = gfx->pipeline_count++;
 
     VkGraphicsPipelineCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -745,6 +1887,43 @@ static Pipeline *create_pipeline(Graphics *gfx, PipelineInfo *info) {
     return pipeline;
 }
 
+// Only the shader, descriptor set layouts, push constant ranges and specialization of info are used.
+static Pipeline *create_compute_pipeline(Graphics *gfx, PipelineInfo *info) {
+    CTK_ASSERT(info->shaders.count == 1);
+    CTK_ASSERT(info->shaders.data[0]->stage == VK_SHADER_STAGE_COMPUTE_BIT);
+
+    VkPipelineLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_create_info.setLayoutCount = info->descriptor_set_layouts.count;
+    layout_create_info.pSetLayouts = info->descriptor_set_layouts.data;
+    layout_create_info.pushConstantRangeCount = info->push_constant_ranges.count;
+    layout_create_info.pPushConstantRanges = info->push_constant_ranges.data;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    validate(vkCreatePipelineLayout(gfx->device, &layout_create_info, NULL, &pipeline_layout),
+             "failed to create compute pipeline layout");
+
+    auto pipeline = allocate<Pipeline>(gfx->mem.perm, 1);
+    pipeline->layout = pipeline_layout;
+    pipeline->id = gfx->pipeline_count++;
+
+    VkComputePipelineCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    create_info.stage.flags = 0;
+    create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    create_info.stage.module = info->shaders.data[0]->handle;
+    create_info.stage.pName = "main";
+    create_info.stage.pSpecializationInfo = info->specialization;
+    create_info.layout = pipeline_layout;
+    create_info.basePipelineHandle = VK_NULL_HANDLE;
+    create_info.basePipelineIndex = -1;
+
+    validate(vkCreateComputePipelines(gfx->device, VK_NULL_HANDLE, 1, &create_info, NULL, &pipeline->handle),
+             "failed to create compute pipeline");
+
+    return pipeline;
+}
+
 static void create_pipelines(Graphics *gfx) {
     // Test
     {
@@ -752,11 +1931,7 @@ static void create_pipelines(Graphics *gfx) {
         push(&info.shaders, gfx->shader.test.vert);
         push(&info.shaders, gfx->shader.test.frag);
         push(&info.color_blend_attachments, DEFAULT_COLOR_BLEND_ATTACHMENT);
-        push(&info.push_constant_ranges, {
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-            .offset = 0,
-            .size = 64
-        });
+        push(&info.descriptor_set_layouts, gfx->descriptor_set.instances->layout);
         push(&info.vertex_bindings, {
             .binding = 0,
             .stride = 20,
@@ -797,12 +1972,24 @@ static void create_pipelines(Graphics *gfx) {
         push(&info.shaders, gfx->shader.texture.vert);
         push(&info.shaders, gfx->shader.texture.frag);
         push(&info.color_blend_attachments, DEFAULT_COLOR_BLEND_ATTACHMENT);
-        push(&info.descriptor_set_layouts, gfx->descriptor_set.texture->layout);
-        push(&info.push_constant_ranges, {
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+
+        // texture.frag's USE_PALETTE constant; single-channel displays are colorized through the palette.
+        VkBool32 use_palette = gfx->display_format != DisplayFormat::RGBA8;
+        VkSpecializationMapEntry use_palette_entry = {
+            .constantID = 0,
             .offset = 0,
-            .size = 64
-        });
+            .size = sizeof(VkBool32),
+        };
+        VkSpecializationInfo specialization = {
+            .mapEntryCount = 1,
+            .pMapEntries = &use_palette_entry,
+            .dataSize = sizeof(use_palette),
+            .pData = &use_palette,
+        };
+        info.specialization = &specialization;
+
+        push(&info.descriptor_set_layouts, gfx->descriptor_set.instances->layout);
+        push(&info.descriptor_set_layouts, gfx->descriptor_set.texture->layout);
         push(&info.vertex_bindings, {
             .binding = 0,
             .stride = 20,
@@ -842,13 +2029,76 @@ static void create_pipelines(Graphics *gfx) {
 
         gfx->pipeline.texture = create_pipeline(gfx, &info);
     }
+
+    // Terrain
+    {
+        PipelineInfo info = DEFAULT_PIPELINE_INFO;
+        push(&info.shaders, gfx->shader.terrain.vert);
+        push(&info.shaders, gfx->shader.terrain.frag);
+        push(&info.color_blend_attachments, DEFAULT_COLOR_BLEND_ATTACHMENT);
+        push(&info.push_constant_ranges, {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(TerrainPushConstants)
+        });
+        push(&info.vertex_bindings, {
+            .binding = 0,
+            .stride = sizeof(TerrainVertex),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        });
+
+        // x, z, height and normal are all fetched as a single uvec4 and decoded in the vertex shader.
+        push(&info.vertex_attributes, {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R16G16B16A16_UINT,
+            .offset = 0,
+        });
+        VkExtent2D surface_extent = get_surface_extent(gfx->physical_device, gfx->surface);
+
+        push(&info.viewports, {
+            .x = 0,
+            .y = 0,
+            .width = (f32)surface_extent.width,
+            .height = (f32)surface_extent.height,
+            .minDepth = 0,
+            .maxDepth = 1
+        });
+        push(&info.scissors, {
+            .offset = { 0, 0 },
+            .extent = surface_extent
+        });
+
+        // Enable depth testing.
+        info.depth_stencil.depthTestEnable = VK_TRUE;
+        info.depth_stencil.depthWriteEnable = VK_TRUE;
+        info.depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+        gfx->pipeline.terrain = create_pipeline(gfx, &info);
+    }
+
+    // Cull
+    {
+        PipelineInfo info = {};
+        push(&info.shaders, gfx->shader.cull);
+        push(&info.descriptor_set_layouts, gfx->descriptor_set.cull->layout);
+        push(&info.push_constant_ranges, {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(CullPushConstants)
+        });
+
+        gfx->pipeline.cull = create_compute_pipeline(gfx, &info);
+    }
 }
 
 static void create_render_state(Graphics *gfx) {
     create_mesh_data(gfx);
     create_shaders(gfx);
     create_images(gfx);
+    create_display_palette(gfx);
     create_samplers(gfx);
+    create_instance_data(gfx);
     create_descriptor_sets(gfx);
     create_pipelines(gfx);
 }
@@ -856,10 +2106,11 @@ static void create_render_state(Graphics *gfx) {
 ////////////////////////////////////////////////////////////
 /// Interface
 ////////////////////////////////////////////////////////////
-static Graphics *create_graphics(Memory *mem, Platform *platform) {
+static Graphics *create_graphics(Memory *mem, Platform *platform, DisplayFormat display_format) {
     auto gfx = allocate<Graphics>(mem, 1);
     gfx->mem.perm = mem;
     gfx->mem.temp = create_stack(gfx->mem.perm, megabyte(6));
+    gfx->display_format = display_format;
 
     create_vulkan_state(gfx, platform);
     create_render_state(gfx);
@@ -871,18 +2122,258 @@ static Mesh *create_mesh(Graphics *gfx, MeshInfo info) {
     auto mesh = allocate<Mesh>(gfx->mem.perm, 1);
     mesh->vertexes = create_array<Vertex>(gfx->mem.perm, info.max_vertex_count);
     mesh->indexes = create_array<u32>(gfx->mem.perm, info.max_index_count);
+    mesh->block = U32_MAX;
     return mesh;
 }
 
+static TerrainMesh *create_terrain_mesh(Graphics *gfx, MeshInfo info) {
+    auto mesh = allocate<TerrainMesh>(gfx->mem.perm, 1);
+    mesh->vertexes = create_array<TerrainVertex>(gfx->mem.perm, info.max_vertex_count);
+    mesh->indexes = create_array<u32>(gfx->mem.perm, info.max_index_count);
+    mesh->block = U32_MAX;
+    return mesh;
+}
+
+static u16 encode_octahedral_normal(Vec3<f32> normal) {
+    // Project onto octahedron, then fold lower hemisphere over upper.
+    f32 l1_norm = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    f32 x = normal.x / l1_norm;
+    f32 y = normal.y / l1_norm;
+
+    if (normal.z < 0) {
+        f32 folded_x = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+        f32 folded_y = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    u16 encoded_x = (u16)((x * 0.5f + 0.5f) * 255 + 0.5f);
+    u16 encoded_y = (u16)((y * 0.5f + 0.5f) * 255 + 0.5f);
+    return encoded_x | encoded_y << 8;
+}
+
+// Builds a grid terrain mesh from a row-major heightfield of normalized [0, 1] heights. height_scale is the world
+// height of 1.0 relative to grid spacing, and is only used for computing normals.
+static void generate_terrain_mesh(TerrainMesh *mesh, f32 *heights, u32 width, u32 depth, f32 height_scale) {
+    CTK_ASSERT(width >= 2 && depth >= 2);
+    CTK_ASSERT(width <= UINT16_MAX + 1 && depth <= UINT16_MAX + 1);
+
+    if (width * depth > mesh->vertexes->size)
+        CTK_FATAL("terrain mesh vertex array (size=%u) too small for %ux%u grid", mesh->vertexes->size, width, depth);
+
+    if ((width - 1) * (depth - 1) * 6 > mesh->indexes->size)
+        CTK_FATAL("terrain mesh index array (size=%u) too small for %ux%u grid", mesh->indexes->size, width, depth);
+
+    clear(mesh->vertexes);
+    clear(mesh->indexes);
+
+    for (u32 z = 0; z < depth; ++z)
+    for (u32 x = 0; x < width; ++x) {
+        // Central difference normal (clamped at edges).
+        f32 west  = heights[(z * width) + (x > 0 ? x - 1 : x)];
+        f32 east  = heights[(z * width) + (x < width - 1 ? x + 1 : x)];
+        f32 north = heights[((z > 0 ? z - 1 : z) * width) + x];
+        f32 south = heights[((z < depth - 1 ? z + 1 : z) * width) + x];
+        Vec3<f32> normal = { (west - east) * height_scale, 2.0f, (north - south) * height_scale };
+
+        f32 height = clamp(heights[(z * width) + x], 0.0f, 1.0f);
+        push(mesh->vertexes, {
+            .x = (u16)x,
+            .z = (u16)z,
+            .height = (u16)(height * UINT16_MAX),
+            .normal = encode_octahedral_normal(normal),
+        });
+    }
+
+    for (u32 z = 0; z < depth - 1; ++z)
+    for (u32 x = 0; x < width - 1; ++x) {
+        u32 nw = (z * width) + x;
+        u32 ne = nw + 1;
+        u32 sw = nw + width;
+        u32 se = sw + 1;
+
+        push(mesh->indexes, nw);
+        push(mesh->indexes, sw);
+        push(mesh->indexes, se);
+
+        push(mesh->indexes, nw);
+        push(mesh->indexes, se);
+        push(mesh->indexes, ne);
+    }
+}
+
+// Releases chained blocks whose ranges have all been freed. The first block is kept for the arena's lifetime.
+template<typename VertexType>
+static void release_empty_mesh_blocks(MeshArena<VertexType> *arena) {
+    for (u32 i = 1; i < arena->blocks.count; ++i) {
+        MeshBlock<VertexType> *block = arena->blocks.data + i;
+        if (mesh_block_released(block))
+            continue;
+
+        bool empty = block->free_vertex_ranges->count == 1 &&
+                     block->free_vertex_ranges->data[0].count == block->vertexes->size &&
+                     block->free_index_ranges->count == 1 &&
+                     block->free_index_ranges->data[0].count == block->indexes->size;
+        if (!empty)
+            continue;
+
+        free_graphics_array(block->vertexes);
+        free_graphics_array(block->indexes);
+    }
+}
+
+static void release_pending_mesh_frees(Graphics *gfx, u32 frame_idx) {
+    FixedArray<PendingMeshFree, MAX_PENDING_MESH_FREES> *pending_frees = gfx->pending_mesh_frees + frame_idx;
+    if (pending_frees->count == 0)
+        return;
+
+    for (u32 i = 0; i < pending_frees->count; ++i) {
+        PendingMeshFree *pending_free = pending_frees->data + i;
+        free_range(pending_free->free_vertex_ranges, pending_free->vertex_range);
+        free_range(pending_free->free_index_ranges, pending_free->index_range);
+    }
+
+    pending_frees->count = 0;
+    release_empty_mesh_blocks(&gfx->mesh_data);
+    release_empty_mesh_blocks(&gfx->terrain_mesh_data);
+}
+
+// Mesh data is freed once the current frame is no longer in flight, or immediately before the first frame, when no
+// frame can be drawing from it.
+template<typename VertexType, typename MeshType>
+static void free_mesh_data(Graphics *gfx, MeshArena<VertexType> *arena, MeshType *mesh) {
+    if (mesh->block == U32_MAX)
+        return;
+
+    MeshBlock<VertexType> *block = arena->blocks.data + mesh->block;
+
+    if (gfx->sync.frame == NULL) {
+        free_range(block->free_vertex_ranges, mesh->vertex_range);
+        free_range(block->free_index_ranges, mesh->index_range);
+        release_empty_mesh_blocks(arena);
+    }
+    else {
+        FixedArray<PendingMeshFree, MAX_PENDING_MESH_FREES> *pending_frees =
+            gfx->pending_mesh_frees + gfx->sync.frame_idx;
+
+        if (pending_frees->count == MAX_PENDING_MESH_FREES) {
+            CTK_FATAL("cannot free mesh data: already at max pending mesh free count of %u",
+                      MAX_PENDING_MESH_FREES);
+        }
+
+        push(pending_frees, {
+            .free_vertex_ranges = block->free_vertex_ranges,
+            .free_index_ranges = block->free_index_ranges,
+            .vertex_range = mesh->vertex_range,
+            .index_range = mesh->index_range,
+        });
+    }
+
+    mesh->block = U32_MAX;
+    mesh->vertex_range = {};
+    mesh->index_range = {};
+}
+
+template<typename VertexType, typename MeshType>
+static bool allocate_mesh_ranges(MeshBlock<VertexType> *block, MeshType *mesh) {
+    if (!allocate_range(block->free_vertex_ranges, mesh->vertexes->count, &mesh->vertex_range))
+        return false;
+
+    // Vertex and index ranges must come from the same block, so give back the vertex range if indexes don't fit.
+    if (!allocate_range(block->free_index_ranges, mesh->indexes->count, &mesh->index_range)) {
+        free_range(block->free_vertex_ranges, mesh->vertex_range);
+        return false;
+    }
+
+    return true;
+}
+
+template<typename VertexType, typename MeshType>
+static void push_mesh_data(Graphics *gfx, MeshArena<VertexType> *arena, MeshType *mesh) {
+    // Re-pushing a mesh replaces its existing data, which frames in flight may still be drawing from, so new data
+    // never reuses it.
+    free_mesh_data(gfx, arena, mesh);
+
+    u32 block_idx = U32_MAX;
+    for (u32 i = 0; i < arena->blocks.count; ++i) {
+        if (!mesh_block_released(arena->blocks.data + i) && allocate_mesh_ranges(arena->blocks.data + i, mesh)) {
+            block_idx = i;
+            break;
+        }
+    }
+
+    // Grow arena by chaining a new block large enough for the mesh.
+    if (block_idx == U32_MAX) {
+        MeshBlock<VertexType> *block = push_mesh_block(gfx, arena,
+                                                       max(arena->block_vertex_count, mesh->vertexes->count),
+                                                       max(arena->block_index_count, mesh->indexes->count));
+        block_idx = (u32)(block - arena->blocks.data);
+
+        if (!allocate_mesh_ranges(block, mesh))
+            CTK_FATAL("failed to allocate mesh data from new mesh block");
+    }
+
+    mesh->block = block_idx;
+    MeshBlock<VertexType> *block = arena->blocks.data + block_idx;
+
+    begin_upload(gfx, UploadQueue::TRANSFER);
+        write(gfx, block->vertexes, mesh->vertex_range.offset, mesh->vertexes->data, mesh->vertex_range.count);
+        write(gfx, block->indexes, mesh->index_range.offset, mesh->indexes->data, mesh->index_range.count);
+    submit_upload(gfx);
+}
+
+// Bounding sphere centered on the vertexes' bounding box; not minimal, but cheap and never smaller than the mesh.
+static void calculate_mesh_bounds(Mesh *mesh) {
+    mesh->bounds_center = {};
+    mesh->bounds_radius = 0.0f;
+
+    if (mesh->vertexes->count == 0)
+        return;
+
+    Vec3<f32> min_position = mesh->vertexes->data[0].position;
+    Vec3<f32> max_position = min_position;
+    for (u32 i = 1; i < mesh->vertexes->count; ++i) {
+        Vec3<f32> position = mesh->vertexes->data[i].position;
+        min_position = { min(min_position.x, position.x), min(min_position.y, position.y),
+                         min(min_position.z, position.z) };
+        max_position = { max(max_position.x, position.x), max(max_position.y, position.y),
+                         max(max_position.z, position.z) };
+    }
+
+    Vec3<f32> center = {
+        (min_position.x + max_position.x) * 0.5f,
+        (min_position.y + max_position.y) * 0.5f,
+        (min_position.z + max_position.z) * 0.5f,
+    };
+
+    f32 max_distance_squared = 0.0f;
+    for (u32 i = 0; i < mesh->vertexes->count; ++i) {
+        Vec3<f32> position = mesh->vertexes->data[i].position;
+        f32 x = position.x - center.x;
+        f32 y = position.y - center.y;
+        f32 z = position.z - center.z;
+        max_distance_squared = max(max_distance_squared, (x * x) + (y * y) + (z * z));
+    }
+
+    mesh->bounds_center = center;
+    mesh->bounds_radius = sqrtf(max_distance_squared);
+}
+
 static void push_mesh_data(Graphics *gfx, Mesh *mesh) {
-    mesh->vertex_offset = gfx->mesh_data.vertexes->count;
-    mesh->index_offset = gfx->mesh_data.indexes->count;
+    calculate_mesh_bounds(mesh);
+    push_mesh_data(gfx, &gfx->mesh_data, mesh);
+}
+
+static void push_mesh_data(Graphics *gfx, TerrainMesh *mesh) {
+    push_mesh_data(gfx, &gfx->terrain_mesh_data, mesh);
+}
+
+static void free_mesh_data(Graphics *gfx, Mesh *mesh) {
+    free_mesh_data(gfx, &gfx->mesh_data, mesh);
+}
 
-    clear(gfx->gfx_mem.staging);
-    begin_temp_cmd_buf(gfx->temp_cmd_buf);
-        push(gfx, gfx->mesh_data.vertexes, mesh->vertexes->data, mesh->vertexes->count);
-        push(gfx, gfx->mesh_data.indexes, mesh->indexes->data, mesh->indexes->count);
-    submit_temp_cmd_buf(gfx->temp_cmd_buf, gfx->queue.graphics);
+static void free_mesh_data(Graphics *gfx, TerrainMesh *mesh) {
+    free_mesh_data(gfx, &gfx->terrain_mesh_data, mesh);
 }
 
 static void next_frame(Graphics *gfx) {
@@ -894,6 +2385,16 @@ static void next_frame(Graphics *gfx) {
     validate(vkWaitForFences(gfx->device, 1, &gfx->sync.frame->in_flight, VK_TRUE, U64_MAX), "vkWaitForFences failed");
     validate(vkResetFences(gfx->device, 1, &gfx->sync.frame->in_flight), "vkResetFences failed");
 
+    // Staging the frame used last time around is no longer being read, and its render threads' command buffers are
+    // no longer executing. Mesh data freed during it is no longer drawn from by it or any earlier frame.
+    gfx->gfx_mem.staging->tail = gfx->sync.frame->staging_end;
+    release_pending_mesh_frees(gfx, gfx->sync.frame_idx);
+
+    for (u32 i = 0; i < gfx->render_thread_count; ++i) {
+        validate(vkResetCommandPool(gfx->device, gfx->render_threads[gfx->sync.frame_idx][i].cmd_pool, 0),
+                 "vkResetCommandPool failed");
+    }
+
     // Once current frame is not in-flight, it is safe to use it's img_aquired semaphore and aquire next swap image.
     validate(
         vkAcquireNextImageKHR(gfx->device, gfx->swapchain->handle, U64_MAX, gfx->sync.frame->img_aquired,
@@ -901,13 +2402,126 @@ static void next_frame(Graphics *gfx) {
         "failed to aquire next swapchain image");
 }
 
-static void begin_render_cmds(Graphics *gfx, VkCommandBuffer cmd_buf) {
+// Begins the current frame's command buffer. Transfers into the frame's resources are recorded before
+// begin_render_cmds(), so the whole frame is a single submission.
+static VkCommandBuffer begin_frame_cmds(Graphics *gfx) {
+    VkCommandBuffer cmd_buf = gfx->primary_render_cmd_bufs->data[gfx->sync.frame_idx];
+
     VkCommandBufferBeginInfo cmd_buf_begin_info = {};
     cmd_buf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmd_buf_begin_info.flags = 0;
+    cmd_buf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     cmd_buf_begin_info.pInheritanceInfo = NULL;
     validate(vkBeginCommandBuffer(cmd_buf, &cmd_buf_begin_info), "failed to begin recording command buffer");
 
+    // Acquire buffer ranges released by transfer uploads. The frame's submission waits on the uploads at vertex input,
+    // so acquires are chained after that wait.
+    CTK_ASSERT(gfx->upload.current == NULL);
+    if (gfx->upload.acquires.count > 0) {
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0,                                                      // Dependency Flags
+                             0, NULL,                                                // Memory Barriers
+                             gfx->upload.acquires.count, gfx->upload.acquires.data,  // Buffer Memory Barriers
+                             0, NULL);                                               // Image Memory Barriers
+        gfx->upload.acquires.count = 0;
+    }
+
+    return cmd_buf;
+}
+
+static CullEntity *get_cull_entities(Graphics *gfx) {
+    return get_mapped(gfx->cull_entities[gfx->sync.frame_idx], 0);
+}
+
+// Frustum culls the first entity_count of the frame's cull entities against view_projection. draws are the frame's draw
+// commands with instanceCount 0; each visible entity is counted in its draw's instanceCount, and its MVP matrix is
+// packed into the draw's instance range, which must have room for all of the draw's entities. Recorded before
+// begin_render_cmds().
+static void record_cull_cmds(Graphics *gfx, VkCommandBuffer cmd_buf, Matrix view_projection, u32 entity_count,
+                             VkDrawIndexedIndirectCommand *draws, u32 draw_count)
+{
+    CTK_ASSERT(entity_count <= MAX_INSTANCES);
+    CTK_ASSERT(draw_count <= MAX_CULL_DRAWS);
+
+    if (draw_count == 0)
+        return;
+
+    u32 frame_idx = gfx->sync.frame_idx;
+    GraphicsMemory *draw_mem = gfx->draw_commands[frame_idx]->mem;
+    GraphicsMemory *instance_mem = gfx->instance_matrixes[frame_idx]->mem;
+    VkDeviceSize draws_size = draw_count * sizeof(VkDrawIndexedIndirectCommand);
+
+    // Reset draw commands, then let the cull pass accumulate instance counts into them.
+    vkCmdUpdateBuffer(cmd_buf, draw_mem->buffer->handle, draw_mem->offset, draws_size, draws);
+    buffer_memory_barrier(cmd_buf, draw_mem->buffer, {
+        .src = {
+            .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        },
+        .dst = {
+            .stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            .access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        },
+        .offset = draw_mem->offset,
+        .size = draws_size,
+    });
+
+    if (entity_count > 0) {
+        CullPushConstants push_constants = {
+            .view_projection = view_projection,
+            .entity_count = entity_count,
+        };
+        vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, gfx->pipeline.cull->handle);
+        vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, gfx->pipeline.cull->layout,
+                                0, 1, &gfx->descriptor_set.cull->handles[frame_idx],
+                                0, NULL);
+        vkCmdPushConstants(cmd_buf, gfx->pipeline.cull->layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                           0, sizeof(push_constants), &push_constants);
+        vkCmdDispatch(cmd_buf, (entity_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    }
+
+    // Draw commands are read by indirect draws and instance matrixes by vertex shaders.
+    VkBufferMemoryBarrier cull_barriers[] = {
+        create_buffer_memory_barrier(draw_mem->buffer, {
+            .src = {
+                .access = VK_ACCESS_SHADER_WRITE_BIT,
+                .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+            },
+            .dst = {
+                .access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+            },
+            .offset = draw_mem->offset,
+            .size = draws_size,
+        }),
+        create_buffer_memory_barrier(instance_mem->buffer, {
+            .src = {
+                .access = VK_ACCESS_SHADER_WRITE_BIT,
+                .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+            },
+            .dst = {
+                .access = VK_ACCESS_SHADER_READ_BIT,
+                .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+            },
+            .offset = instance_mem->offset,
+            .size = instance_mem->size,
+        }),
+    };
+    vkCmdPipelineBarrier(cmd_buf,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0,                                           // Dependency Flags
+                         0, NULL,                                     // Memory Barriers
+                         CTK_ARRAY_SIZE(cull_barriers), cull_barriers, // Buffer Memory Barriers
+                         0, NULL);                                    // Image Memory Barriers
+}
+
+// Render pass contents are recorded into render thread command buffers and executed with execute_render_thread_cmds().
+static void begin_render_cmds(Graphics *gfx, VkCommandBuffer cmd_buf) {
     VkRenderPassBeginInfo rp_begin_info = {};
     rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     rp_begin_info.renderPass = gfx->render_pass->handle;
@@ -918,24 +2532,100 @@ static void begin_render_cmds(Graphics *gfx, VkCommandBuffer cmd_buf) {
         .offset = { 0, 0 },
         .extent = gfx->swapchain->extent,
     };
-    vkCmdBeginRenderPass(cmd_buf, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(cmd_buf, &rp_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+}
+
+// Begins render thread thread_idx's command buffer for the current frame, continuing the render pass begun by
+// begin_render_cmds(). Only called from the thread recording it; secondary command buffers inherit no bound state.
+static VkCommandBuffer begin_render_thread_cmds(Graphics *gfx, u32 thread_idx) {
+    CTK_ASSERT(thread_idx < gfx->render_thread_count);
+
+    VkCommandBuffer cmd_buf = gfx->render_threads[gfx->sync.frame_idx][thread_idx].cmd_buf;
+
+    VkCommandBufferInheritanceInfo inheritance_info = {};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = gfx->render_pass->handle;
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = gfx->framebuffers->data[gfx->sync.swap_img_idx];
+
+    VkCommandBufferBeginInfo cmd_buf_begin_info = {};
+    cmd_buf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmd_buf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                               VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    cmd_buf_begin_info.pInheritanceInfo = &inheritance_info;
+    validate(vkBeginCommandBuffer(cmd_buf, &cmd_buf_begin_info), "failed to begin recording command buffer");
+
+    return cmd_buf;
 }
 
-static void bind_mesh_data(Graphics *gfx, VkCommandBuffer cmd_buf) {
+static void end_render_thread_cmds(VkCommandBuffer cmd_buf) {
+    validate(vkEndCommandBuffer(cmd_buf), "failed to end recording command buffer");
+}
+
+// Executes the first thread_count render threads' command buffers in thread order.
+static void execute_render_thread_cmds(Graphics *gfx, VkCommandBuffer cmd_buf, u32 thread_count) {
+    CTK_ASSERT(thread_count <= gfx->render_thread_count);
+
+    if (thread_count == 0)
+        return;
+
+    VkCommandBuffer thread_cmd_bufs[MAX_RENDER_THREADS];
+    for (u32 i = 0; i < thread_count; ++i)
+        thread_cmd_bufs[i] = gfx->render_threads[gfx->sync.frame_idx][i].cmd_buf;
+
+    vkCmdExecuteCommands(cmd_buf, thread_count, thread_cmd_bufs);
+}
+
+template<typename VertexType>
+static void bind_mesh_block(VkCommandBuffer cmd_buf, MeshBlock<VertexType> *block) {
     vkCmdBindVertexBuffers(cmd_buf,
                            0, // First Binding
                            1, // Binding Count
-                           &gfx->mesh_data.vertexes->mem->buffer->handle,
-                           &gfx->mesh_data.vertexes->mem->offset);
+                           &block->vertexes->mem->buffer->handle,
+                           &block->vertexes->mem->offset);
 
     vkCmdBindIndexBuffer(cmd_buf,
-                         gfx->mesh_data.indexes->mem->buffer->handle,
-                         gfx->mesh_data.indexes->mem->offset,
+                         block->indexes->mem->buffer->handle,
+                         block->indexes->mem->offset,
                          VK_INDEX_TYPE_UINT32);
 }
 
-static void draw_mesh(Graphics *gfx, VkCommandBuffer cmd_buf, Mesh *mesh) {
-    vkCmdDrawIndexed(cmd_buf, mesh->indexes->count, 1, mesh->index_offset, mesh->vertex_offset, 0);
+static void bind_mesh_data(Graphics *gfx, VkCommandBuffer cmd_buf, u32 block_idx) {
+    bind_mesh_block(cmd_buf, gfx->mesh_data.blocks.data + block_idx);
+}
+
+static void bind_terrain_mesh_data(Graphics *gfx, VkCommandBuffer cmd_buf, u32 block_idx) {
+    bind_mesh_block(cmd_buf, gfx->terrain_mesh_data.blocks.data + block_idx);
+}
+
+template<typename MeshType>
+static void draw_mesh(Graphics *gfx, VkCommandBuffer cmd_buf, MeshType *mesh) {
+    vkCmdDrawIndexed(cmd_buf, mesh->index_range.count, 1, mesh->index_range.offset, mesh->vertex_range.offset, 0);
+}
+
+// Draws instance_count instances of mesh, whose matrixes start at first_instance in the frame's instance matrixes.
+template<typename MeshType>
+static void draw_mesh_instances(Graphics *gfx, VkCommandBuffer cmd_buf, MeshType *mesh, u32 first_instance,
+                                u32 instance_count)
+{
+    vkCmdDrawIndexed(cmd_buf, mesh->index_range.count, instance_count, mesh->index_range.offset,
+                     mesh->vertex_range.offset, first_instance);
+}
+
+// Draws draw_count of the frame's draw commands from first_draw, written by record_cull_cmds(). All draws must use the
+// bound pipeline and mesh block. Without multiDrawIndirect, each draw is a separate indirect draw.
+static void draw_indirect(Graphics *gfx, VkCommandBuffer cmd_buf, u32 first_draw, u32 draw_count) {
+    GraphicsMemory *draw_mem = gfx->draw_commands[gfx->sync.frame_idx]->mem;
+    VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize offset = draw_mem->offset + (first_draw * stride);
+
+    if (gfx->multi_draw_indirect) {
+        vkCmdDrawIndexedIndirect(cmd_buf, draw_mem->buffer->handle, offset, draw_count, stride);
+    }
+    else {
+        for (u32 i = 0; i < draw_count; ++i)
+            vkCmdDrawIndexedIndirect(cmd_buf, draw_mem->buffer->handle, offset + (i * stride), 1, stride);
+    }
 }
 
 static void end_render_cmds(Graphics *gfx, VkCommandBuffer cmd_buf) {
@@ -944,21 +2634,33 @@ static void end_render_cmds(Graphics *gfx, VkCommandBuffer cmd_buf) {
 }
 
 static void submit_render_cmds(Graphics *gfx) {
-    // Rendering
-    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Rendering waits on the swap image and, if any were submitted since the last frame, uploads.
+    VkSemaphore wait_semaphores[] = {
+        gfx->sync.frame->img_aquired,
+        gfx->upload.pending,
+    };
+    VkPipelineStageFlags wait_stages[] = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    };
 
     VkSubmitInfo submit_info = {};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submit_info.pNext = NULL;
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &gfx->sync.frame->img_aquired;
-    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.waitSemaphoreCount = gfx->upload.pending != VK_NULL_HANDLE ? 2 : 1;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
     submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &gfx->primary_render_cmd_bufs->data[gfx->sync.swap_img_idx];
+    submit_info.pCommandBuffers = &gfx->primary_render_cmd_bufs->data[gfx->sync.frame_idx];
     submit_info.signalSemaphoreCount = 1;
     submit_info.pSignalSemaphores = &gfx->sync.frame->render_finished;
 
     validate(vkQueueSubmit(gfx->queue.graphics, 1, &submit_info, gfx->sync.frame->in_flight), "vkQueueSubmit failed");
+    gfx->upload.pending = VK_NULL_HANDLE;
+
+    // Everything staged so far, including uploads before the first frame, has been read once this submission's fence
+    // signals. Uploads staged after this point are waited on by the next submission, so they belong to that frame.
+    gfx->sync.frame->staging_end = gfx->gfx_mem.staging->head;
 
     // Presentation
     VkPresentInfoKHR present_info = {};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ctk/ctk.h"
+
+using namespace ctk;
+
+typedef f32 (*InterpFunc)(f32 t);
+
+static f32 lerp(f32 a, f32 b, f32 t) {
+    return a + ((b - a) * t);
+}
+
+static f32 linear(f32 t) {
+    return t;
+}
+
+static f32 smoothstep(f32 t) {
+    return t * t * (3 - (2 * t));
+}
+
+static f32 smootherstep(f32 t) {
+    return t * t * t * ((3 * t * ((2 * t) - 5)) + 10);
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "ctk/ctk.h"
+#include "ctk/math.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+#include "noise_test/graphics.h"
+#include "noise_test/noise_utils.h"
+#include "noise_test/threads.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+
+// Cubic grid of density samples, stored x-major then y then z. A field with N samples per axis has N - 1 cells per axis.
+struct DensityField {
+    f32 *values;
+    u32 sample_count;
+};
+
+struct DensityInfo {
+    Vec3<f32> offset;
+    f32 frequency;
+    InterpFunc interp_func;
+};
+
+struct IsosurfaceInfo {
+    f32 iso_level;
+    Vec3<f32> origin;
+    f32 cell_size;
+};
+
+// Range of z cell slabs extracted by one task.
+struct IsosurfaceTask {
+    u32 z_begin;
+    u32 z_end;
+    u32 vertex_count;
+    u32 index_count;
+    u32 vertex_offset;
+    u32 index_offset;
+
+    // Sliding window of vertex indexes for the current and previous cell slab.
+    u32 *slab_vertexes[2];
+};
+
+// Cube corners are indexed by bits (x = 1, y = 2, z = 4); each edge joins two corners differing in one bit.
+static constexpr u32 CUBE_EDGES[12][2] = {
+    { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }, // X
+    { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 }, // Y
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }, // Z
+};
+
+////////////////////////////////////////////////////////////
+/// Utils
+////////////////////////////////////////////////////////////
+static u32 sample_index(DensityField *field, u32 x, u32 y, u32 z) {
+    return (((z * field->sample_count) + y) * field->sample_count) + x;
+}
+
+// Returns mask of cell corners inside the surface, from per-sample inside flags.
+static u32 cell_mask(DensityField *field, u8 *inside, u32 x, u32 y, u32 z) {
+    u32 y_stride = field->sample_count;
+    u32 z_stride = field->sample_count * field->sample_count;
+    u8 *corner0 = inside + sample_index(field, x, y, z);
+
+    return corner0[0]
+         | corner0[1] << 1
+         | corner0[y_stride] << 2
+         | corner0[y_stride + 1] << 3
+         | corner0[z_stride] << 4
+         | corner0[z_stride + 1] << 5
+         | corner0[z_stride + y_stride] << 6
+         | corner0[z_stride + y_stride + 1] << 7;
+}
+
+static void load_cell_corners(DensityField *field, u32 x, u32 y, u32 z, f32 *corners) {
+    for (u32 corner = 0; corner < 8; ++corner) {
+        corners[corner] = field->values[sample_index(field, x + (corner & 1), y + ((corner >> 1) & 1),
+                                                     z + ((corner >> 2) & 1))];
+    }
+}
+
+// Bit i is set if the cell edge leaving corner 0 along axis i crosses the surface.
+static u32 corner_edge_mask(u32 mask) {
+    u32 edge_mask = 0;
+
+    for (u32 axis = 0; axis < 3; ++axis) {
+        if (((mask >> 0) & 1) != ((mask >> (1 << axis)) & 1))
+            edge_mask |= 1 << axis;
+    }
+
+    return edge_mask;
+}
+
+// Quads are emitted for corner-0 edges whose 3 other adjacent cells exist, i.e. cell isn't on the low boundary of
+// either axis perpendicular to the edge.
+static u32 cell_quad_count(u32 edge_mask, u32 x, u32 y, u32 z) {
+    u32 cell[3] = { x, y, z };
+    u32 count = 0;
+
+    for (u32 axis = 0; axis < 3; ++axis) {
+        if ((edge_mask & (1 << axis)) && cell[(axis + 1) % 3] > 0 && cell[(axis + 2) % 3] > 0)
+            ++count;
+    }
+
+    return count;
+}
+
+static Vertex cell_vertex(IsosurfaceInfo *info, f32 *corners, u32 mask, u32 x, u32 y, u32 z) {
+    // Place vertex at average of the cell's edge crossings.
+    Vec3<f32> crossing_sum = {};
+    u32 crossing_count = 0;
+
+    for (u32 edge = 0; edge < 12; ++edge) {
+        u32 a = CUBE_EDGES[edge][0];
+        u32 b = CUBE_EDGES[edge][1];
+
+        if (((mask >> a) & 1) == ((mask >> b) & 1))
+            continue;
+
+        f32 t = (info->iso_level - corners[a]) / (corners[b] - corners[a]);
+        Vec3<f32> corner_a = { (f32)(a & 1), (f32)((a >> 1) & 1), (f32)((a >> 2) & 1) };
+        Vec3<f32> corner_b = { (f32)(b & 1), (f32)((b >> 1) & 1), (f32)((b >> 2) & 1) };
+        crossing_sum += corner_a + (t * (corner_b - corner_a));
+        ++crossing_count;
+    }
+
+    f32 crossing_scale = info->cell_size / crossing_count;
+    return {
+        .position = {
+            info->origin.x + (x * info->cell_size) + (crossing_sum.x * crossing_scale),
+            info->origin.y + (y * info->cell_size) + (crossing_sum.y * crossing_scale),
+            info->origin.z + (z * info->cell_size) + (crossing_sum.z * crossing_scale),
+        },
+        .uv = {},
+    };
+}
+
+static void count_isosurface_task(DensityField *field, u8 *inside, IsosurfaceTask *task) {
+    u32 cell_count = field->sample_count - 1;
+
+    // Slab before z_begin is only generated for its vertexes so quads crossing into it can be emitted.
+    u32 vertex_z_begin = task->z_begin > 0 ? task->z_begin - 1 : 0;
+    task->vertex_count = 0;
+    task->index_count = 0;
+
+    for (u32 z = vertex_z_begin; z < task->z_end; ++z)
+    for (u32 y = 0; y < cell_count; ++y)
+    for (u32 x = 0; x < cell_count; ++x) {
+        u32 mask = cell_mask(field, inside, x, y, z);
+
+        if (mask == 0 || mask == 0xFF)
+            continue;
+
+        ++task->vertex_count;
+
+        if (z >= task->z_begin)
+            task->index_count += cell_quad_count(corner_edge_mask(mask), x, y, z) * 6;
+    }
+}
+
+static void extract_isosurface_task(DensityField *field, u8 *inside, IsosurfaceInfo *info, IsosurfaceTask *task,
+                                    Mesh *mesh)
+{
+    u32 cell_count = field->sample_count - 1;
+    u32 slab_stride[3] = { 1, cell_count, 0 };
+    f32 corners[8];
+
+    Vertex *vertexes = mesh->vertexes->data + task->vertex_offset;
+    u32 *indexes = mesh->indexes->data + task->index_offset;
+    u32 vertex_count = 0;
+    u32 index_count = 0;
+
+    u32 vertex_z_begin = task->z_begin > 0 ? task->z_begin - 1 : 0;
+
+    for (u32 z = vertex_z_begin; z < task->z_end; ++z) {
+        u32 *curr_slab = task->slab_vertexes[z & 1];
+        u32 *prev_slab = task->slab_vertexes[(z + 1) & 1];
+
+        for (u32 y = 0; y < cell_count; ++y)
+        for (u32 x = 0; x < cell_count; ++x) {
+            u32 slab_idx = (y * cell_count) + x;
+            u32 mask = cell_mask(field, inside, x, y, z);
+
+            if (mask == 0 || mask == 0xFF) {
+                curr_slab[slab_idx] = U32_MAX;
+                continue;
+            }
+
+            load_cell_corners(field, x, y, z, corners);
+            curr_slab[slab_idx] = task->vertex_offset + vertex_count;
+            vertexes[vertex_count++] = cell_vertex(info, corners, mask, x, y, z);
+
+            if (z < task->z_begin)
+                continue;
+
+            // Emit a quad joining the 4 cells around each crossing corner-0 edge; neighbors along z come from the
+            // previous slab.
+            u32 edge_mask = corner_edge_mask(mask);
+            u32 cell[3] = { x, y, z };
+
+            for (u32 axis = 0; axis < 3; ++axis) {
+                u32 u_axis = (axis + 1) % 3;
+                u32 v_axis = (axis + 2) % 3;
+
+                if (!(edge_mask & (1 << axis)) || cell[u_axis] == 0 || cell[v_axis] == 0)
+                    continue;
+
+                auto neighbor = [&](bool step_u, bool step_v) {
+                    bool prev = (step_u && u_axis == 2) || (step_v && v_axis == 2);
+                    u32 idx = slab_idx - (step_u ? slab_stride[u_axis] : 0) - (step_v ? slab_stride[v_axis] : 0);
+                    return (prev ? prev_slab : curr_slab)[idx];
+                };
+
+                u32 a = neighbor(false, false);
+                u32 b = neighbor(true, false);
+                u32 c = neighbor(true, true);
+                u32 d = neighbor(false, true);
+
+                // Wind quad so it faces out of the surface.
+                if (mask & 1) {
+                    indexes[index_count++] = a; indexes[index_count++] = b; indexes[index_count++] = c;
+                    indexes[index_count++] = a; indexes[index_count++] = c; indexes[index_count++] = d;
+                }
+                else {
+                    indexes[index_count++] = a; indexes[index_count++] = d; indexes[index_count++] = c;
+                    indexes[index_count++] = a; indexes[index_count++] = c; indexes[index_count++] = b;
+                }
+            }
+        }
+    }
+
+    CTK_ASSERT(vertex_count == task->vertex_count);
+    CTK_ASSERT(index_count == task->index_count);
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static DensityField *create_density_field(Memory *mem, u32 cell_count) {
+    auto field = allocate<DensityField>(mem, 1);
+    field->sample_count = cell_count + 1;
+    field->values = allocate<f32>(mem, field->sample_count * field->sample_count * field->sample_count);
+    return field;
+}
+
+static void generate_density_field(DensityField *field, Array<f32> *noise, DensityInfo info) {
+    u32 sample_count = field->sample_count;
+
+    // Each z sample slice is a task.
+    parallel_for(sample_count, [&](u32 z) {
+        f32 sample_z = (info.offset.z + z) / info.frequency;
+
+        for (u32 y = 0; y < sample_count; ++y)
+        for (u32 x = 0; x < sample_count; ++x) {
+            f32 sample_x = (info.offset.x + x) / info.frequency;
+            f32 sample_y = (info.offset.y + y) / info.frequency;
+            field->values[sample_index(field, x, y, z)] = sample_3d(noise, sample_x, sample_y, sample_z,
+                                                                    info.interp_func);
+        }
+    });
+}
+
+// Extracts surface of density field at info.iso_level into mesh using naive surface nets (one vertex per cell
+// straddling the surface, one quad per crossing edge). Field is split into z slab ranges extracted in parallel: a
+// counting pass sizes each range's output so tasks write directly into the mesh arrays. Vertexes on range seams are
+// duplicated rather than shared between tasks.
+static void extract_isosurface(Memory *temp_mem, Mesh *mesh, DensityField *field, IsosurfaceInfo info) {
+    CTK_ASSERT(field->sample_count >= 2);
+
+    push_frame(temp_mem);
+
+    u32 cell_count = field->sample_count - 1;
+    u32 task_count = min(cell_count, worker_thread_count() * 2);
+    auto tasks = allocate<IsosurfaceTask>(temp_mem, task_count);
+
+    for (u32 i = 0; i < task_count; ++i) {
+        IsosurfaceTask *task = tasks + i;
+        task->z_begin = (cell_count * i) / task_count;
+        task->z_end = (cell_count * (i + 1)) / task_count;
+        task->slab_vertexes[0] = allocate<u32>(temp_mem, cell_count * cell_count);
+        task->slab_vertexes[1] = allocate<u32>(temp_mem, cell_count * cell_count);
+    }
+
+    // Classify samples once so counting and extraction only touch densities of cells straddling the surface.
+    u32 slice_size = field->sample_count * field->sample_count;
+    u8 *inside = allocate<u8>(temp_mem, slice_size * field->sample_count);
+
+    parallel_for(field->sample_count, [&](u32 z) {
+        for (u32 i = z * slice_size; i < (z + 1) * slice_size; ++i)
+            inside[i] = field->values[i] > info.iso_level;
+    });
+
+    parallel_for(task_count, [&](u32 task_idx) {
+        count_isosurface_task(field, inside, tasks + task_idx);
+    });
+
+    // Assign each task its output range in the mesh.
+    u32 vertex_total = 0;
+    u32 index_total = 0;
+
+    for (u32 i = 0; i < task_count; ++i) {
+        tasks[i].vertex_offset = vertex_total;
+        tasks[i].index_offset = index_total;
+        vertex_total += tasks[i].vertex_count;
+        index_total += tasks[i].index_count;
+    }
+
+    if (vertex_total > mesh->vertexes->size)
+        CTK_FATAL("isosurface needs %u vertexes but mesh only has room for %u", vertex_total, mesh->vertexes->size);
+
+    if (index_total > mesh->indexes->size)
+        CTK_FATAL("isosurface needs %u indexes but mesh only has room for %u", index_total, mesh->indexes->size);
+
+    parallel_for(task_count, [&](u32 task_idx) {
+        extract_isosurface_task(field, inside, &info, tasks + task_idx, mesh);
+    });
+
+    mesh->vertexes->count = vertex_total;
+    mesh->indexes->count = index_total;
+
+    pop_frame(temp_mem);
+}
@@ -5,14 +5,16 @@
 #include "noise_test/game.h"
 #include "noise_test/noise_utils.h"
 #include "noise_test/noise_1d.h"
-// #include "noise_test/noise_2d.h"
+#include "noise_test/noise_2d.h"
 
 using namespace ctk;
 using namespace stk;
 
 s32 main() {
+    start_worker_threads();
+
     // Memory
-    Memory *mem = create_stack(megabyte(64));
+    Memory *mem = create_stack(megabyte(128));
     Memory *platform_mem = create_stack(mem, kilobyte(2));
     Memory *graphics_mem = create_stack(mem, megabyte(8));
 
@@ -28,9 +30,17 @@ s32 main() {
         .title = L"Game",
     });
 
-    Graphics *gfx = create_graphics(graphics_mem, platform);
+    Graphics *gfx = create_graphics(graphics_mem, platform, DisplayFormat::RGBA8);
     Game *game = create_game(mem, gfx);
-    NoiseTest *noise_test = create_noise_test(game);
+
+    // Both noise tests are created up front and switched between with N, starting with the 2D test.
+    noise_1d::NoiseTest *noise_test_1d = noise_1d::create_noise_test(game);
+    noise_2d::NoiseTest *noise_test_2d = noise_2d::create_noise_test(game);
+    bool show_noise_2d = true;
+
+    // Display is fully cleared once; after that only regions drawn the previous frame are cleared.
+    static constexpr u32 CLEAR_COLOR = 0xFF101010;
+    clear_display(game, CLEAR_COLOR);
 
     // Main Loop
     while (1) {
@@ -46,7 +56,17 @@ s32 main() {
         // Input and controls.
         update_mouse(game, window, gfx);
         controls(game, gfx, platform);
-        noise_test_controls(window, noise_test);
+
+        if (key_pressed(window, Key::N)) {
+            show_noise_2d = !show_noise_2d;
+            game->view->transform.position.z = show_noise_2d ? noise_2d::FULL_DISPLAY_VIEW_Z :
+                                                               noise_1d::FULL_DISPLAY_VIEW_Z;
+        }
+
+        if (show_noise_2d)
+            noise_2d::noise_test_controls(game, window, noise_test_2d);
+        else
+            noise_1d::noise_test_controls(game, window, noise_test_1d);
 
         // Input closed window.
         if (!window->open)
@@ -55,17 +75,21 @@ s32 main() {
         next_frame(gfx);
 
         // Draw noise to display texture.
-        clear_display(game, 0xFF101010);
-        noise_test_display(game, noise_test);
-        update_display(game, gfx);
+        clear_dirty_display(game, CLEAR_COLOR);
+        if (show_noise_2d)
+            noise_2d::noise_test_display(game, noise_test_2d);
+        else
+            noise_1d::noise_test_display(game, noise_test_1d);
 
-        // Render entities.
+        // Render entities, uploading the display first.
         update_entity_data(game);
         update_descriptor_data(game, gfx);
         record_render_cmds(game, gfx);
         submit_render_cmds(gfx);
     }
 
+    stop_worker_threads();
+
     return 0;
 }
 
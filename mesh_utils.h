@@ -0,0 +1,301 @@
+#pragma once
+
+#include <math.h>
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct MeshOptimizationStats {
+    f32 acmr_before;
+    f32 acmr_after;
+};
+
+// Forsyth vertex cache scoring parameters.
+static constexpr u32 VERTEX_CACHE_SIZE = 32;
+static constexpr u32 MAX_VERTEX_VALENCE_SCORE = 32;
+static constexpr f32 VERTEX_CACHE_DECAY_POWER = 1.5f;
+static constexpr f32 VERTEX_LAST_TRI_SCORE = 0.75f;
+static constexpr f32 VERTEX_VALENCE_BOOST_SCALE = 2.0f;
+static constexpr f32 VERTEX_VALENCE_BOOST_POWER = 0.5f;
+
+// Cache size used when measuring ACMR (average cache miss ratio, or vertex transforms per triangle).
+static constexpr u32 ACMR_FIFO_SIZE = 16;
+
+struct VertexCacheScores {
+    f32 cache[VERTEX_CACHE_SIZE];
+    f32 valence[MAX_VERTEX_VALENCE_SCORE];
+};
+
+////////////////////////////////////////////////////////////
+/// Utils
+////////////////////////////////////////////////////////////
+static VertexCacheScores create_vertex_cache_scores() {
+    VertexCacheScores scores = {};
+
+    for (u32 cache_pos = 0; cache_pos < VERTEX_CACHE_SIZE; ++cache_pos) {
+        // Vertexes used by the last triangle get a fixed score so the next triangle doesn't just reuse its edge.
+        if (cache_pos < 3) {
+            scores.cache[cache_pos] = VERTEX_LAST_TRI_SCORE;
+        }
+        else {
+            f32 scaler = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            scores.cache[cache_pos] = powf(1.0f - ((cache_pos - 3) * scaler), VERTEX_CACHE_DECAY_POWER);
+        }
+    }
+
+    // Boost vertexes with few remaining triangles so they get finished off and stop occupying the cache.
+    for (u32 valence = 1; valence < MAX_VERTEX_VALENCE_SCORE; ++valence)
+        scores.valence[valence] = VERTEX_VALENCE_BOOST_SCALE * powf((f32)valence, -VERTEX_VALENCE_BOOST_POWER);
+
+    return scores;
+}
+
+static f32 vertex_score(VertexCacheScores *scores, s32 cache_pos, u32 valence) {
+    // Vertex has no triangles left to add.
+    if (valence == 0)
+        return -1.0f;
+
+    f32 score = cache_pos >= 0 ? scores->cache[cache_pos] : 0.0f;
+    score += scores->valence[min(valence, MAX_VERTEX_VALENCE_SCORE - 1)];
+    return score;
+}
+
+static f32 calculate_acmr(Memory *temp_mem, u32 *indexes, u32 index_count, u32 vertex_count) {
+    if (index_count < 3)
+        return 0.0f;
+
+    push_frame(temp_mem);
+
+    // Vertex is in FIFO cache if fewer than ACMR_FIFO_SIZE misses have happened since it was loaded.
+    u32 *load_time = allocate<u32>(temp_mem, vertex_count);
+    for (u32 i = 0; i < vertex_count; ++i)
+        load_time[i] = U32_MAX;
+
+    u32 misses = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 vertex = indexes[i];
+
+        if (load_time[vertex] == U32_MAX || misses - load_time[vertex] >= ACMR_FIFO_SIZE) {
+            load_time[vertex] = misses;
+            ++misses;
+        }
+    }
+
+    pop_frame(temp_mem);
+
+    return (f32)misses / (index_count / 3);
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+
+// Reorders triangles for post-transform vertex cache reuse using Tom Forsyth's linear-speed algorithm. Only triangles
+// touching vertexes in the simulated cache are rescored after each step, so cost is linear in triangle count.
+static void optimize_vertex_cache(Memory *temp_mem, u32 *indexes, u32 index_count, u32 vertex_count) {
+    CTK_ASSERT(index_count % 3 == 0);
+
+    u32 tri_count = index_count / 3;
+    if (tri_count == 0)
+        return;
+
+    push_frame(temp_mem);
+
+    VertexCacheScores scores = create_vertex_cache_scores();
+
+    // Vertex State
+    u32 *valence = allocate<u32>(temp_mem, vertex_count);
+    u32 *adjacency_offset = allocate<u32>(temp_mem, vertex_count + 1);
+    s32 *cache_pos = allocate<s32>(temp_mem, vertex_count);
+    f32 *vertex_scores = allocate<f32>(temp_mem, vertex_count);
+
+    // Triangle State
+    u32 *adjacency = allocate<u32>(temp_mem, index_count);
+    f32 *tri_scores = allocate<f32>(temp_mem, tri_count);
+    bool *tri_added = allocate<bool>(temp_mem, tri_count);
+    u32 *output = allocate<u32>(temp_mem, index_count);
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        valence[i] = 0;
+        cache_pos[i] = -1;
+    }
+
+    for (u32 i = 0; i < index_count; ++i) {
+        CTK_ASSERT(indexes[i] < vertex_count);
+        ++valence[indexes[i]];
+    }
+
+    // Build per-vertex triangle adjacency lists. Each vertex's active triangles are kept at the front of its list
+    // (length valence) so removing a triangle is a swap.
+    adjacency_offset[0] = 0;
+    for (u32 i = 0; i < vertex_count; ++i)
+        adjacency_offset[i + 1] = adjacency_offset[i] + valence[i];
+
+    {
+        u32 *fill = allocate<u32>(temp_mem, vertex_count);
+        for (u32 i = 0; i < vertex_count; ++i)
+            fill[i] = 0;
+
+        for (u32 i = 0; i < index_count; ++i) {
+            u32 vertex = indexes[i];
+            adjacency[adjacency_offset[vertex] + fill[vertex]++] = i / 3;
+        }
+    }
+
+    for (u32 i = 0; i < vertex_count; ++i)
+        vertex_scores[i] = vertex_score(&scores, -1, valence[i]);
+
+    u32 best_tri = 0;
+    f32 best_score = -1.0f;
+    for (u32 tri = 0; tri < tri_count; ++tri) {
+        tri_added[tri] = false;
+        tri_scores[tri] = vertex_scores[indexes[(tri * 3) + 0]] +
+                          vertex_scores[indexes[(tri * 3) + 1]] +
+                          vertex_scores[indexes[(tri * 3) + 2]];
+
+        if (tri_scores[tri] > best_score) {
+            best_score = tri_scores[tri];
+            best_tri = tri;
+        }
+    }
+
+    // Cache holds up to 3 extra vertexes while a newly added triangle pushes older entries out.
+    u32 cache[VERTEX_CACHE_SIZE + 3];
+    u32 cache_count = 0;
+    u32 next_unadded_tri = 0;
+
+    for (u32 output_tri = 0; output_tri < tri_count; ++output_tri) {
+        // Fall back to linear scan for next unadded triangle if no cached triangle scored.
+        if (best_score < 0.0f) {
+            while (tri_added[next_unadded_tri])
+                ++next_unadded_tri;
+
+            best_tri = next_unadded_tri;
+        }
+
+        // Output triangle and remove it from its vertexes' active adjacency.
+        u32 *tri_vertexes = indexes + (best_tri * 3);
+        tri_added[best_tri] = true;
+
+        for (u32 corner = 0; corner < 3; ++corner) {
+            u32 vertex = tri_vertexes[corner];
+            output[(output_tri * 3) + corner] = vertex;
+
+            u32 *vertex_adjacency = adjacency + adjacency_offset[vertex];
+            for (u32 i = 0; i < valence[vertex]; ++i) {
+                if (vertex_adjacency[i] == best_tri) {
+                    vertex_adjacency[i] = vertex_adjacency[valence[vertex] - 1];
+                    vertex_adjacency[valence[vertex] - 1] = best_tri;
+                    break;
+                }
+            }
+
+            --valence[vertex];
+        }
+
+        // Move triangle's vertexes to front of cache, keeping the order of the rest.
+        u32 new_cache[VERTEX_CACHE_SIZE + 3];
+        u32 new_cache_count = 0;
+
+        for (u32 corner = 0; corner < 3; ++corner)
+            new_cache[new_cache_count++] = tri_vertexes[corner];
+
+        for (u32 i = 0; i < cache_count; ++i) {
+            u32 vertex = cache[i];
+
+            if (vertex != tri_vertexes[0] && vertex != tri_vertexes[1] && vertex != tri_vertexes[2])
+                new_cache[new_cache_count++] = vertex;
+        }
+
+        // Rescore cached vertexes (and ones that just fell out) and the triangles still using them.
+        best_score = -1.0f;
+        for (u32 i = 0; i < new_cache_count; ++i) {
+            u32 vertex = new_cache[i];
+            cache_pos[vertex] = i < VERTEX_CACHE_SIZE ? (s32)i : -1;
+            vertex_scores[vertex] = vertex_score(&scores, cache_pos[vertex], valence[vertex]);
+        }
+
+        for (u32 i = 0; i < new_cache_count; ++i) {
+            u32 vertex = new_cache[i];
+            u32 *vertex_adjacency = adjacency + adjacency_offset[vertex];
+
+            for (u32 j = 0; j < valence[vertex]; ++j) {
+                u32 tri = vertex_adjacency[j];
+                tri_scores[tri] = vertex_scores[indexes[(tri * 3) + 0]] +
+                                  vertex_scores[indexes[(tri * 3) + 1]] +
+                                  vertex_scores[indexes[(tri * 3) + 2]];
+
+                if (tri_scores[tri] > best_score) {
+                    best_score = tri_scores[tri];
+                    best_tri = tri;
+                }
+            }
+        }
+
+        cache_count = min(new_cache_count, VERTEX_CACHE_SIZE);
+        memcpy(cache, new_cache, cache_count * sizeof(u32));
+    }
+
+    memcpy(indexes, output, index_count * sizeof(u32));
+
+    pop_frame(temp_mem);
+}
+
+// Reorders vertexes by first use in the index buffer so vertex fetches walk memory linearly, and remaps indexes to
+// match. Unreferenced vertexes are moved to the end.
+template<typename VertexType>
+static void optimize_vertex_fetch(Memory *temp_mem, VertexType *vertexes, u32 vertex_count, u32 *indexes,
+                                  u32 index_count)
+{
+    push_frame(temp_mem);
+
+    u32 *remap = allocate<u32>(temp_mem, vertex_count);
+    VertexType *reordered = allocate<VertexType>(temp_mem, vertex_count);
+
+    for (u32 i = 0; i < vertex_count; ++i)
+        remap[i] = U32_MAX;
+
+    u32 next_vertex = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 vertex = indexes[i];
+
+        if (remap[vertex] == U32_MAX) {
+            remap[vertex] = next_vertex;
+            reordered[next_vertex] = vertexes[vertex];
+            ++next_vertex;
+        }
+
+        indexes[i] = remap[vertex];
+    }
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        if (remap[i] == U32_MAX)
+            reordered[next_vertex++] = vertexes[i];
+    }
+
+    memcpy(vertexes, reordered, vertex_count * sizeof(VertexType));
+
+    pop_frame(temp_mem);
+}
+
+// Runs vertex cache and vertex fetch optimization on a Mesh or TerrainMesh before it is pushed with push_mesh_data().
+template<typename MeshType>
+static MeshOptimizationStats optimize_mesh(Memory *temp_mem, MeshType *mesh) {
+    u32 *indexes = mesh->indexes->data;
+    u32 index_count = mesh->indexes->count;
+    u32 vertex_count = mesh->vertexes->count;
+
+    MeshOptimizationStats stats = {};
+    stats.acmr_before = calculate_acmr(temp_mem, indexes, index_count, vertex_count);
+
+    optimize_vertex_cache(temp_mem, indexes, index_count, vertex_count);
+    optimize_vertex_fetch(temp_mem, mesh->vertexes->data, vertex_count, indexes, index_count);
+
+    stats.acmr_after = calculate_acmr(temp_mem, indexes, index_count, vertex_count);
+    return stats;
+}
@@ -11,6 +11,8 @@
 using namespace ctk;
 using namespace stk;
 
+namespace noise_1d {
+
 struct Graph {
     u32 width;
     u32 height;
@@ -22,6 +24,9 @@ struct Graph {
 static u32 constexpr BASE_GRAPH_COUNT = 3;
 static u32 constexpr COMPOSITE_GRAPH_INDEX = BASE_GRAPH_COUNT;
 
+// Game view distance that shows the full display.
+static f32 constexpr FULL_DISPLAY_VIEW_Z = -4.5f;
+
 struct NoiseTest {
     Array<f32> *noise;
     Array<Graph> *graphs;
@@ -107,7 +112,7 @@ static NoiseTest *create_noise_test(Game *game) {
     }
 
     // Adjust game view to show full display.
-    game->view->transform.position.z = -4.5f;
+    game->view->transform.position.z = FULL_DISPLAY_VIEW_Z;
 
     generate_noise(noise_test->noise, time(NULL));
     generate_graph_samples(noise_test);
@@ -123,14 +128,12 @@ static void draw_graph(Game *game, InterpFunc interp_func, Graph *graph) {
         s32 dir = val > prev_val ? 1 :
                   val < prev_val ? -1 :
                   0;
-        s32 y = prev_val + dir;
 
-        do {
-            u32 pixel_x = graph->x_origin + graph_pixel_x;
-            u32 pixel_y = graph->y_origin + y;
-            draw_point(game, pixel_x, pixel_y, { .color = 0xFF0000FF, .scale = 1 });
-            y += dir;
-        } while (y != val + dir);
+        // Connect to previous value with a vertical span ending at val.
+        s32 start = prev_val + dir;
+        s32 min_y = min(start, val);
+        s32 height = max(start, val) - min_y + 1;
+        draw_vertical_span(game, graph->x_origin + graph_pixel_x, graph->y_origin + min_y, height, 0xFF0000FF);
 
         prev_val = val;
     }
@@ -141,7 +144,7 @@ static void noise_test_display(Game *game, NoiseTest *noise_test) {
         draw_graph(game, noise_test->interp_func, get_ptr(noise_test->graphs, i));
 }
 
-static void noise_test_controls(Window *window, NoiseTest *noise_test) {
+static void noise_test_controls(Game *game, Window *window, NoiseTest *noise_test) {
     if (interp_func_controls(window, &noise_test->interp_func))
         generate_graph_samples(noise_test);
 
@@ -150,3 +153,5 @@ static void noise_test_controls(Window *window, NoiseTest *noise_test) {
         generate_graph_samples(noise_test);
     }
 }
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include "ctk/ctk.h"
 #include "ctk/math.h"
 #include "ctk/memory.h"
@@ -11,41 +12,168 @@
 using namespace ctk;
 using namespace stk;
 
+namespace noise_2d {
+
 struct DisplayInfo {
-    f32 frequency;
+    f32 frequency; // Display pixels per noise lattice unit.
     f32 frequency_scaling_factor;
     u32 size;
     u32 x_origin;
     u32 y_origin;
+    f32 frame_budget_ms; // Time per frame spent generating and refining tiles.
+
+    // View center in noise lattice units.
+    f64 center_x;
+    f64 center_y;
+};
+
+// Game view distance that shows the full display.
+static constexpr f32 FULL_DISPLAY_VIEW_Z = -1.3f;
+
+// Noise is cached in a quadtree of fixed-size tiles, like a slippy map. Level 0 tiles are sampled at
+// LEVEL_0_FREQUENCY pixels per lattice unit, and each level up halves the frequency, so a tile covers the same area as
+// its 4 children at the level below.
+static constexpr u32 TILE_SIZE = 64;
+static constexpr u32 MAX_TILE_LEVEL = 8;
+static constexpr f32 LEVEL_0_FREQUENCY = 256.0f;
+static constexpr u32 MAX_CACHED_TILES = 256;
+
+// Tiles are generated progressively: the first pass samples every COARSE_TILE_STEP-th pixel and later passes halve the
+// step until every pixel is sampled.
+static constexpr u32 COARSE_TILE_STEP = 8;
+
+struct NoiseTile {
+    s32 x;
+    s32 y;
+    u32 level;
+    bool valid;
+    u32 last_used_frame;
+    u32 step; // Spacing of samples taken so far; 1 when tile is exact.
+    f32 values[TILE_SIZE * TILE_SIZE];
+    u8 texels[TILE_SIZE * TILE_SIZE * MAX_DISPLAY_TEXEL_SIZE]; // Values colorized in the display's format.
+};
+
+// Tiles to draw from for one visible tile slot: the tile itself, its children when zooming out past them, or its
+// closest cached ancestor.
+struct TileSource {
+    NoiseTile *tile;
+    NoiseTile *children[4];
+    NoiseTile *ancestor;
+};
+
+// Visible tiles at the level being drawn from, resolved once per frame that needs compositing.
+struct TileView {
+    u32 level;
+    f32 frequency;
+    f64 min_world_x;
+    f64 min_world_y;
+    s32 min_tile_x;
+    s32 min_tile_y;
+    u32 tile_count_x;
+    u32 tile_count_y;
+    TileSource *sources;
+};
+
+// Last composited display window. While valid it was drawn entirely from exact tiles at frequency and center, so
+// an unchanged view is reused as is and a panned view only composites the newly revealed strips.
+struct ViewCache {
+    u8 *texels;
+    f32 frequency;
+    f64 center_x;
+    f64 center_y;
+    bool valid;
+};
+
+// Palettes cycled through with P. Only used by RGBA8 displays; others are colorized by the display palette.
+static ColorGradient NOISE_GRADIENTS[] = {
+    // Grayscale
+    {
+        .stops = {
+            { 0.0f, 0xFF000000 },
+            { 1.0f, 0xFFFFFFFF },
+        },
+        .stop_count = 2,
+    },
+    // Terrain
+    {
+        .stops = {
+            { 0.00f, 0xFF801000 },
+            { 0.40f, 0xFFC85A1E },
+            { 0.45f, 0xFF96D2E6 },
+            { 0.55f, 0xFF3CA03C },
+            { 0.70f, 0xFF286420 },
+            { 0.85f, 0xFF646E78 },
+            { 1.00f, 0xFFFAFAFA },
+        },
+        .stop_count = 7,
+    },
+    // Heat
+    {
+        .stops = {
+            { 0.0f, 0xFF000000 },
+            { 0.4f, 0xFF0000C8 },
+            { 0.8f, 0xFF00DCFF },
+            { 1.0f, 0xFFFFFFFF },
+        },
+        .stop_count = 4,
+    },
 };
 
 struct NoiseTest {
     DisplayInfo *display_info;
+    DisplayFormat display_format;
+    u32 texel_size;
+    ColorLUT *palette;
+    u32 gradient;
+    bool dither;
     Array<f32> *noise;
     InterpFunc interp_func;
+    NoiseTile *tiles;
+    ViewCache view;
+    u32 frame;
 };
 
 static DisplayInfo *create_display_info(Game *game) {
     auto display_info = allocate<DisplayInfo>(game->mem.perm, 1);
     display_info->frequency = 100.0f;
     display_info->frequency_scaling_factor = 1.03f;
+    display_info->frame_budget_ms = 4.0f;
     display_info->size = 256;
+    display_info->center_x = 0.0;
+    display_info->center_y = 0.0;
 
     // Center display.
     display_info->x_origin = (game->display.width - display_info->size) / 2;
     display_info->y_origin = (game->display.height - display_info->size) / 2;
 
     // Adjust game view to show full display.
-    game->view->transform.position.z = -1.3f;
+    game->view->transform.position.z = FULL_DISPLAY_VIEW_Z;
 
     return display_info;
 }
 
 static NoiseTest *create_noise_test(Game *game) {
     auto noise_test = allocate<NoiseTest>(game->mem.perm, 1);
-    noise_test->noise = create_noise(game, 0xDEADBEEF);
+    noise_test->noise = create_array_full<f32>(game->mem.perm, PERMUTATION_SIZE);
     noise_test->display_info = create_display_info(game);
+    noise_test->display_format = game->display.format;
+    noise_test->texel_size = game->display.texel_size;
+    noise_test->palette = allocate<ColorLUT>(game->mem.perm, 1);
+    noise_test->gradient = 0;
+    noise_test->dither = false;
     noise_test->interp_func = smootherstep;
+    noise_test->tiles = allocate<NoiseTile>(game->mem.perm, MAX_CACHED_TILES);
+    u32 view_size = noise_test->display_info->size;
+    noise_test->view.texels = allocate<u8>(game->mem.perm, view_size * view_size * noise_test->texel_size);
+    noise_test->view.valid = false;
+    noise_test->frame = 0;
+
+    for (u32 i = 0; i < MAX_CACHED_TILES; ++i)
+        noise_test->tiles[i].valid = false;
+
+    generate_noise(noise_test->noise, 0xDEADBEEF);
+    create_color_lut(noise_test->palette, NOISE_GRADIENTS + noise_test->gradient);
+
     return noise_test;
 }
 
@@ -84,35 +212,348 @@ static f32 sample(Array<f32> *noise, f32 x, f32 y, InterpFunc interp_func) {
     return lerp(south_edge_val, north_edge_val, step_y);
 }
 
-static inline u32 shade_color(u8 shade) {
-    return 0xFF000000   // A (default 255)
-         | shade << 0   // R
-         | shade << 8   // G
-         | shade << 16; // B
+static f32 level_frequency(u32 level) {
+    return LEVEL_0_FREQUENCY / (1 << level);
+}
+
+// Floor division so negative pixel coordinates land in negative tiles.
+static s32 tile_coord(s64 pixel) {
+    return (s32)(pixel >= 0 ? pixel / TILE_SIZE : ((pixel + 1) / (s64)TILE_SIZE) - 1);
+}
+
+// Noise repeats every PERMUTATION_SIZE lattice units, so coordinates are wrapped into range before sampling to allow
+// panning to negative coordinates.
+static f32 wrap_lattice(f64 val) {
+    return (f32)(val - (floor(val / PERMUTATION_SIZE) * PERMUTATION_SIZE));
+}
+
+// Converts a tile's values to texels. Sampling only writes values, so palette changes just colorize tiles again.
+static void colorize_tile(NoiseTest *noise_test, NoiseTile *tile) {
+    if (noise_test->display_format == DisplayFormat::RGBA8) {
+        colorize(noise_test->palette, tile->values, (u32 *)tile->texels, TILE_SIZE, TILE_SIZE, noise_test->dither);
+        return;
+    }
+
+    // Single-channel texels are colorized on the GPU.
+    u32 texel_size = noise_test->texel_size;
+    for (u32 i = 0; i < TILE_SIZE * TILE_SIZE; ++i) {
+        u32 texel = shade_texel(noise_test->display_format, tile->values[i]);
+        store_texel(tile->texels + (i * texel_size), texel_size, texel);
+    }
+}
+
+// Takes the next sampling pass on a tile: COARSE_TILE_STEP spacing on a new tile, then half the previous spacing,
+// skipping pixels earlier passes sampled. Each sample is splatted over the step x step block it stands for, so the
+// tile can be drawn after any pass.
+static void refine_tile(NoiseTest *noise_test, NoiseTile *tile) {
+    u32 prev_step = tile->step;
+    u32 step = prev_step == 0 ? COARSE_TILE_STEP : prev_step / 2;
+    f64 inv_frequency = 1.0 / level_frequency(tile->level);
+    s64 pixel_x = (s64)tile->x * TILE_SIZE;
+    s64 pixel_y = (s64)tile->y * TILE_SIZE;
+
+    for (u32 y = 0; y < TILE_SIZE; y += step) {
+        f32 sample_y = wrap_lattice((pixel_y + y) * inv_frequency);
+
+        for (u32 x = 0; x < TILE_SIZE; x += step) {
+            if (prev_step != 0 && x % prev_step == 0 && y % prev_step == 0)
+                continue;
+
+            f32 sample_x = wrap_lattice((pixel_x + x) * inv_frequency);
+            f32 val = sample(noise_test->noise, sample_x, sample_y, noise_test->interp_func);
+
+            for (u32 block_y = y; block_y < y + step; ++block_y)
+            for (u32 block_x = x; block_x < x + step; ++block_x)
+                tile->values[(block_y * TILE_SIZE) + block_x] = val;
+        }
+    }
+
+    tile->step = step;
+    colorize_tile(noise_test, tile);
+}
+
+static NoiseTile *find_tile(NoiseTest *noise_test, u32 level, s32 x, s32 y) {
+    // Linear scan is cheap at this cache size and only runs a few times per visible tile per frame.
+    for (u32 i = 0; i < MAX_CACHED_TILES; ++i) {
+        NoiseTile *tile = noise_test->tiles + i;
+
+        if (tile->valid && tile->level == level && tile->x == x && tile->y == y) {
+            tile->last_used_frame = noise_test->frame;
+            return tile;
+        }
+    }
+
+    return NULL;
+}
+
+// Takes the coarse pass of a tile in an empty slot, or else the least recently used one. Returns NULL if every tile
+// was used this frame.
+static NoiseTile *push_tile(NoiseTest *noise_test, u32 level, s32 x, s32 y) {
+    NoiseTile *tile = NULL;
+
+    for (u32 i = 0; i < MAX_CACHED_TILES; ++i) {
+        NoiseTile *candidate = noise_test->tiles + i;
+
+        if (!candidate->valid) {
+            tile = candidate;
+            break;
+        }
+
+        if (candidate->last_used_frame != noise_test->frame &&
+            (tile == NULL || candidate->last_used_frame < tile->last_used_frame))
+        {
+            tile = candidate;
+        }
+    }
+
+    if (tile == NULL)
+        return NULL;
+
+    tile->x = x;
+    tile->y = y;
+    tile->level = level;
+    tile->valid = true;
+    tile->last_used_frame = noise_test->frame;
+    tile->step = 0;
+    refine_tile(noise_test, tile);
+
+    return tile;
+}
+
+static void invalidate_tiles(NoiseTest *noise_test) {
+    for (u32 i = 0; i < MAX_CACHED_TILES; ++i)
+        noise_test->tiles[i].valid = false;
+
+    noise_test->view.valid = false;
+}
+
+// Colorizes cached tiles again after a palette or dither change, keeping their sampled values.
+static void recolorize_tiles(NoiseTest *noise_test) {
+    for (u32 i = 0; i < MAX_CACHED_TILES; ++i) {
+        if (noise_test->tiles[i].valid)
+            colorize_tile(noise_test, noise_test->tiles + i);
+    }
+
+    noise_test->view.valid = false;
+}
+
+// Finds a source for every tile slot in view, then spends the rest of the frame budget refining visible tiles one
+// pass at a time, coarsest first, so detail converges evenly over the view. Missing tiles get their coarse pass while
+// budget remains; until then, their slots fall back to cached children (when zooming out) or the closest cached
+// ancestor (when zooming in or panning).
+static void resolve_tile_view(Game *game, NoiseTest *noise_test, TileView *tile_view) {
+    DisplayInfo *display_info = noise_test->display_info;
+    auto frame_start = std::chrono::steady_clock::now();
+    auto budget_left = [&]() {
+        std::chrono::duration<f32, std::milli> elapsed = std::chrono::steady_clock::now() - frame_start;
+        return elapsed.count() < display_info->frame_budget_ms;
+    };
+
+    // Draw from the coarsest level that still has at least one tile pixel per display pixel.
+    u32 level = 0;
+    while (level < MAX_TILE_LEVEL && level_frequency(level + 1) >= display_info->frequency)
+        ++level;
+
+    f32 frequency = level_frequency(level);
+    f64 half_extent = (display_info->size / 2.0) / display_info->frequency;
+    s32 max_tile_x = tile_coord((s64)floor((display_info->center_x + half_extent) * frequency));
+    s32 max_tile_y = tile_coord((s64)floor((display_info->center_y + half_extent) * frequency));
+
+    tile_view->level = level;
+    tile_view->frequency = frequency;
+    tile_view->min_world_x = display_info->center_x - half_extent;
+    tile_view->min_world_y = display_info->center_y - half_extent;
+    tile_view->min_tile_x = tile_coord((s64)floor(tile_view->min_world_x * frequency));
+    tile_view->min_tile_y = tile_coord((s64)floor(tile_view->min_world_y * frequency));
+    tile_view->tile_count_x = max_tile_x - tile_view->min_tile_x + 1;
+    tile_view->tile_count_y = max_tile_y - tile_view->min_tile_y + 1;
+    tile_view->sources = allocate<TileSource>(game->mem.temp, tile_view->tile_count_x * tile_view->tile_count_y);
+
+    for (u32 tile_y = 0; tile_y < tile_view->tile_count_y; ++tile_y)
+    for (u32 tile_x = 0; tile_x < tile_view->tile_count_x; ++tile_x) {
+        s32 x = tile_view->min_tile_x + tile_x;
+        s32 y = tile_view->min_tile_y + tile_y;
+        TileSource *source = tile_view->sources + (tile_y * tile_view->tile_count_x) + tile_x;
+        *source = {};
+        source->tile = find_tile(noise_test, level, x, y);
+
+        if (source->tile == NULL && budget_left())
+            source->tile = push_tile(noise_test, level, x, y);
+
+        if (source->tile != NULL)
+            continue;
+
+        if (level > 0) {
+            for (u32 quadrant = 0; quadrant < 4; ++quadrant) {
+                s32 child_x = (x * 2) + (quadrant & 1);
+                s32 child_y = (y * 2) + (quadrant >> 1);
+                source->children[quadrant] = find_tile(noise_test, level - 1, child_x, child_y);
+            }
+        }
+
+        for (u32 shift = 1; level + shift <= MAX_TILE_LEVEL && source->ancestor == NULL; ++shift)
+            source->ancestor = find_tile(noise_test, level + shift, x >> shift, y >> shift);
+    }
+
+    u32 source_count = tile_view->tile_count_x * tile_view->tile_count_y;
+    for (u32 step = COARSE_TILE_STEP; step > 1 && budget_left(); step /= 2) {
+        for (u32 i = 0; i < source_count && budget_left(); ++i) {
+            NoiseTile *tile = tile_view->sources[i].tile;
+            if (tile != NULL && tile->step == step)
+                refine_tile(noise_test, tile);
+        }
+    }
+}
+
+// Composites view pixels in [min, max) from the tile view. Returns false if any pixel came from a fallback or
+// partially refined tile, or wasn't covered by any cached tile.
+static bool composite_view(NoiseTest *noise_test, TileView *tile_view, u32 min_x, u32 min_y, u32 max_x, u32 max_y) {
+    DisplayInfo *display_info = noise_test->display_info;
+    u8 *view_texels = noise_test->view.texels;
+    u32 texel_size = noise_test->texel_size;
+    bool complete = true;
+
+    for (u32 y = min_y; y < max_y; ++y) {
+        f64 world_y = tile_view->min_world_y + (y / display_info->frequency);
+
+        for (u32 x = min_x; x < max_x; ++x) {
+            f64 world_x = tile_view->min_world_x + (x / display_info->frequency);
+            s64 pixel_x = (s64)floor(world_x * tile_view->frequency);
+            s64 pixel_y = (s64)floor(world_y * tile_view->frequency);
+            u32 tile_x = clamp(tile_coord(pixel_x) - tile_view->min_tile_x, 0, (s32)tile_view->tile_count_x - 1);
+            u32 tile_y = clamp(tile_coord(pixel_y) - tile_view->min_tile_y, 0, (s32)tile_view->tile_count_y - 1);
+            TileSource *source = tile_view->sources + (tile_y * tile_view->tile_count_x) + tile_x;
+
+            NoiseTile *tile = source->tile;
+            if (tile == NULL || tile->step != 1)
+                complete = false;
+
+            if (tile == NULL) {
+                s32 child_x = tile_coord((s64)floor(world_x * tile_view->frequency * 2));
+                s32 child_y = tile_coord((s64)floor(world_y * tile_view->frequency * 2));
+                NoiseTile *child = source->children[(child_x & 1) | ((child_y & 1) << 1)];
+                tile = child != NULL ? child : source->ancestor;
+            }
+
+            u8 *view_texel = view_texels + (((y * display_info->size) + x) * texel_size);
+
+            if (tile == NULL) {
+                store_texel(view_texel, texel_size, 0);
+                continue;
+            }
+
+            f32 tile_frequency = level_frequency(tile->level);
+            s32 tile_pixel_x = (s32)((s64)floor(world_x * tile_frequency) - ((s64)tile->x * TILE_SIZE));
+            s32 tile_pixel_y = (s32)((s64)floor(world_y * tile_frequency) - ((s64)tile->y * TILE_SIZE));
+            tile_pixel_x = clamp(tile_pixel_x, 0, (s32)TILE_SIZE - 1);
+            tile_pixel_y = clamp(tile_pixel_y, 0, (s32)TILE_SIZE - 1);
+
+            memcpy(view_texel, tile->texels + (((tile_pixel_y * TILE_SIZE) + tile_pixel_x) * texel_size), texel_size);
+        }
+    }
+
+    return complete;
+}
+
+// Moves view pixels so pixel (x, y) holds what was at (x + shift_x, y + shift_y). Pixels shifted in from outside are
+// left stale for the caller to composite.
+static void shift_view(NoiseTest *noise_test, s32 shift_x, s32 shift_y) {
+    u32 size = noise_test->display_info->size;
+    u32 texel_size = noise_test->texel_size;
+    u8 *texels = noise_test->view.texels;
+    u32 pitch = size * texel_size;
+    u32 copy_bytes = (size - abs(shift_x)) * texel_size;
+    u32 dst_x = max(-shift_x, 0) * texel_size;
+    u32 src_x = max(shift_x, 0) * texel_size;
+
+    // Walk rows away from the direction of the shift so no source row is overwritten before it's read.
+    if (shift_y >= 0) {
+        for (u32 y = 0; y + shift_y < size; ++y)
+            memmove(texels + (y * pitch) + dst_x, texels + ((y + shift_y) * pitch) + src_x, copy_bytes);
+    }
+    else {
+        for (u32 y = size; y-- > (u32)-shift_y;)
+            memmove(texels + (y * pitch) + dst_x, texels + ((y + shift_y) * pitch) + src_x, copy_bytes);
+    }
 }
 
 static void noise_test_display(Game *game, NoiseTest *noise_test) {
     DisplayInfo *display_info = noise_test->display_info;
+    ViewCache *view = &noise_test->view;
+    u32 size = display_info->size;
+    ++noise_test->frame;
+
+    // Pans by whole display pixels at an unchanged frequency can reuse the cached view.
+    f64 shift_x = (display_info->center_x - view->center_x) * display_info->frequency;
+    f64 shift_y = (display_info->center_y - view->center_y) * display_info->frequency;
+    s32 pixel_shift_x = (s32)round(shift_x);
+    s32 pixel_shift_y = (s32)round(shift_y);
+    bool reuse_view = view->valid && view->frequency == display_info->frequency &&
+                      fabs(shift_x - pixel_shift_x) < 0.001 && fabs(shift_y - pixel_shift_y) < 0.001 &&
+                      (u32)abs(pixel_shift_x) < size && (u32)abs(pixel_shift_y) < size;
+
+    if (!reuse_view || pixel_shift_x != 0 || pixel_shift_y != 0) {
+        push_frame(game->mem.temp);
+
+        TileView tile_view = {};
+        resolve_tile_view(game, noise_test, &tile_view);
+
+        if (reuse_view) {
+            shift_view(noise_test, pixel_shift_x, pixel_shift_y);
 
-    for (u32 y = 0; y < display_info->size; ++y)
-    for (u32 x = 0; x < display_info->size; ++x) {
-        f32 sample_x = x / display_info->frequency;
-        f32 sample_y = y / display_info->frequency;
-        u32 color = shade_color(255 * sample(noise_test->noise, sample_x, sample_y, noise_test->interp_func));
+            // Composite revealed rows across the full width, then revealed columns in the remaining rows.
+            u32 row_min = pixel_shift_y > 0 ? size - pixel_shift_y : 0;
+            u32 row_max = pixel_shift_y > 0 ? size : -pixel_shift_y;
+            u32 col_min = pixel_shift_x > 0 ? size - pixel_shift_x : 0;
+            u32 col_max = pixel_shift_x > 0 ? size : -pixel_shift_x;
+            u32 kept_row_min = pixel_shift_y > 0 ? 0 : row_max;
+            u32 kept_row_max = pixel_shift_y > 0 ? row_min : size;
 
-        u32 pixel_x = display_info->x_origin + x;
-        u32 pixel_y = display_info->y_origin + y;
-        draw_point(game, pixel_x, pixel_y, { .color = color, .scale = 1 });
+            bool rows_complete = composite_view(noise_test, &tile_view, 0, row_min, size, row_max);
+            bool cols_complete = composite_view(noise_test, &tile_view, col_min, kept_row_min, col_max, kept_row_max);
+            view->valid = rows_complete && cols_complete;
+        }
+        else {
+            view->valid = composite_view(noise_test, &tile_view, 0, 0, size, size);
+        }
+
+        view->frequency = display_info->frequency;
+        view->center_x = display_info->center_x;
+        view->center_y = display_info->center_y;
+
+        pop_frame(game->mem.temp);
     }
+
+    blit(game, display_info->x_origin, display_info->y_origin, view->texels, size, size, size);
 }
 
-static void noise_test_controls(Window *window, NoiseTest *noise_test) {
+static void noise_test_controls(Game *game, Window *window, NoiseTest *noise_test) {
     DisplayInfo *display_info = noise_test->display_info;
 
-    interp_func_controls(window, &noise_test->interp_func);
+    // Only invalidate cached tiles when a parameter actually changes, not on every frame a key is held.
+    InterpFunc prev_interp_func = noise_test->interp_func;
+    if (interp_func_controls(window, &noise_test->interp_func) && noise_test->interp_func != prev_interp_func)
+        invalidate_tiles(noise_test);
+
+    if (key_pressed(window, Key::G)) {
+        generate_noise(noise_test->noise, time(NULL));
+        invalidate_tiles(noise_test);
+    }
+
+    // Palette
+    if (key_pressed(window, Key::P)) {
+        noise_test->gradient = (noise_test->gradient + 1) % CTK_ARRAY_SIZE(NOISE_GRADIENTS);
+        create_color_lut(noise_test->palette, NOISE_GRADIENTS + noise_test->gradient);
+        recolorize_tiles(noise_test);
+    }
+
+    if (key_pressed(window, Key::B)) {
+        noise_test->dither = !noise_test->dither;
+        recolorize_tiles(noise_test);
+    }
 
     // Frequency
-    static constexpr f32 FREQ_MAX = 100.0f;
+    static constexpr f32 FREQ_MAX = LEVEL_0_FREQUENCY;
     static constexpr f32 FREQ_MIN = 1.0f;
     f32 freq_scale_inc = display_info->frequency_scaling_factor;
     f32 freq_scale_dec = 1 / display_info->frequency_scaling_factor;
@@ -122,4 +563,12 @@ static void noise_test_controls(Window *window, NoiseTest *noise_test) {
 
     if (key_down(window, Key::LEFT))
         display_info->frequency = max(display_info->frequency * freq_scale_dec, FREQ_MIN);
+
+    // Pan by dragging with the left mouse button.
+    if (mouse_button_down(window, 0)) {
+        display_info->center_x -= game->input.mouse_delta.x / display_info->frequency;
+        display_info->center_y -= game->input.mouse_delta.y / display_info->frequency;
+    }
+}
+
 }
@@ -1,31 +1,110 @@
 #pragma once
 
+#include <emmintrin.h>
 #include "ctk/ctk.h"
 #include "ctk/memory.h"
 #include "ctk/containers.h"
 #include "stk/stk.h"
 #include "noise_test/game.h"
+#include "noise_test/interp.h"
 #include "noise_test/permutation.h"
 
 using namespace ctk;
 using namespace stk;
 
-typedef f32 (*InterpFunc)(f32 t);
+static constexpr u32 MAX_GRADIENT_STOPS = 8;
+static constexpr u32 COLOR_LUT_SIZE = 256;
 
-static f32 lerp(f32 a, f32 b, f32 t) {
-    return a + ((b - a) * t);
-}
+struct GradientStop {
+    f32 position; // In [0, 1], increasing from stop to stop.
+    u32 color;
+};
+
+struct ColorGradient {
+    GradientStop stops[MAX_GRADIENT_STOPS];
+    u32 stop_count;
+};
+
+// Gradient sampled at COLOR_LUT_SIZE evenly spaced values in [0, 1], so colorizing a value is a table lookup.
+struct ColorLUT {
+    u32 colors[COLOR_LUT_SIZE];
+};
+
+// 4x4 Bayer matrix thresholds, in 16ths.
+static constexpr u32 BAYER_4X4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
 
-static f32 linear(f32 t) {
-    return t;
+static u32 lerp_color(u32 a, u32 b, f32 t) {
+    u32 color = 0;
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        f32 channel = lerp((f32)((a >> shift) & 0xFF), (f32)((b >> shift) & 0xFF), t);
+        color |= (u32)(channel + 0.5f) << shift;
+    }
+
+    return color;
 }
 
-static f32 smoothstep(f32 t) {
-    return t * t * (3 - (2 * t));
+static void create_color_lut(ColorLUT *lut, ColorGradient *gradient) {
+    CTK_ASSERT(gradient->stop_count > 0 && gradient->stop_count <= MAX_GRADIENT_STOPS);
+
+    GradientStop *stops = gradient->stops;
+    u32 stop = 0;
+
+    for (u32 i = 0; i < COLOR_LUT_SIZE; ++i) {
+        f32 value = (f32)i / (COLOR_LUT_SIZE - 1);
+        while (stop + 1 < gradient->stop_count && stops[stop + 1].position <= value)
+            ++stop;
+
+        if (stop + 1 == gradient->stop_count || value <= stops[stop].position) {
+            lut->colors[i] = stops[stop].color;
+            continue;
+        }
+
+        f32 t = (value - stops[stop].position) / (stops[stop + 1].position - stops[stop].position);
+        lut->colors[i] = lerp_color(stops[stop].color, stops[stop + 1].color, t);
+    }
 }
 
-static f32 smootherstep(f32 t) {
-    return t * t * t * ((3 * t * ((2 * t) - 5)) + 10);
+// Maps a width x height block of values in [0, 1] to LUT colors, 4 values at a time. Values are scaled to LUT indexes
+// and rounded; with dither set, rounding uses a 4x4 ordered dither threshold instead, which breaks up banding between
+// neighbouring LUT entries. Dither thresholds repeat every 4 pixels, so blocks whose origins are multiples of 4 tile
+// seamlessly.
+static void colorize(ColorLUT *lut, f32 *values, u32 *pixels, u32 width, u32 height, bool dither) {
+    __m128 scale = _mm_set1_ps(COLOR_LUT_SIZE - 1);
+    __m128 min_index = _mm_setzero_ps();
+    __m128 max_index = _mm_set1_ps(COLOR_LUT_SIZE - 1);
+
+    for (u32 y = 0; y < height; ++y) {
+        f32 offsets[4];
+        for (u32 i = 0; i < 4; ++i)
+            offsets[i] = dither ? (BAYER_4X4[y & 3][i] + 0.5f) / 16.0f : 0.5f;
+
+        __m128 offset = _mm_loadu_ps(offsets);
+        f32 *row_values = values + (y * width);
+        u32 *row_pixels = pixels + (y * width);
+        u32 x = 0;
+
+        for (; x + 4 <= width; x += 4) {
+            __m128 index = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row_values + x), scale), offset);
+            index = _mm_min_ps(_mm_max_ps(index, min_index), max_index);
+
+            u32 indexes[4];
+            _mm_storeu_si128((__m128i *)indexes, _mm_cvttps_epi32(index));
+            _mm_storeu_si128((__m128i *)(row_pixels + x), _mm_setr_epi32(lut->colors[indexes[0]],
+                                                                         lut->colors[indexes[1]],
+                                                                         lut->colors[indexes[2]],
+                                                                         lut->colors[indexes[3]]));
+        }
+
+        for (; x < width; ++x) {
+            f32 index = clamp((row_values[x] * (COLOR_LUT_SIZE - 1)) + offsets[x & 3], 0.0f, COLOR_LUT_SIZE - 1.0f);
+            row_pixels[x] = lut->colors[(u32)index];
+        }
+    }
 }
 
 static void generate_noise(Array<f32> *noise, u32 seed) {
@@ -34,6 +113,38 @@ static void generate_noise(Array<f32> *noise, u32 seed) {
         set(noise, graph_idx, random_range(0.0f, 1.0f));
 }
 
+static f32 noise_val_3d(Array<f32> *noise, u32 x, u32 y, u32 z) {
+    CTK_ASSERT(x < PERMUTATION_SIZE);
+    CTK_ASSERT(y < PERMUTATION_SIZE);
+    CTK_ASSERT(z < PERMUTATION_SIZE);
+    return get(noise, PERMUTATION[PERMUTATION[PERMUTATION[x] + y] + z]);
+}
+
+static f32 sample_3d(Array<f32> *noise, f32 x, f32 y, f32 z, InterpFunc interp_func) {
+    u32 x_floor = (u32)x;
+    u32 y_floor = (u32)y;
+    u32 z_floor = (u32)z;
+
+    f32 step_x = interp_func(x - x_floor);
+    f32 step_y = interp_func(y - y_floor);
+    f32 step_z = interp_func(z - z_floor);
+
+    u32 x0 = x_floor & PERMUTATION_SIZE_MASK;
+    u32 x1 = (x0 + 1) & PERMUTATION_SIZE_MASK;
+    u32 y0 = y_floor & PERMUTATION_SIZE_MASK;
+    u32 y1 = (y0 + 1) & PERMUTATION_SIZE_MASK;
+    u32 z0 = z_floor & PERMUTATION_SIZE_MASK;
+    u32 z1 = (z0 + 1) & PERMUTATION_SIZE_MASK;
+
+    // Interpolate along x, then y, then z.
+    f32 y0_z0 = lerp(noise_val_3d(noise, x0, y0, z0), noise_val_3d(noise, x1, y0, z0), step_x);
+    f32 y1_z0 = lerp(noise_val_3d(noise, x0, y1, z0), noise_val_3d(noise, x1, y1, z0), step_x);
+    f32 y0_z1 = lerp(noise_val_3d(noise, x0, y0, z1), noise_val_3d(noise, x1, y0, z1), step_x);
+    f32 y1_z1 = lerp(noise_val_3d(noise, x0, y1, z1), noise_val_3d(noise, x1, y1, z1), step_x);
+
+    return lerp(lerp(y0_z0, y1_z0, step_y), lerp(y0_z1, y1_z1, step_y), step_z);
+}
+
 static bool interp_func_controls(Window *window, InterpFunc *interp_func) {
     if (key_down(window, Key::F1)) {
         *interp_func = linear;
@@ -0,0 +1,11 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (location = 0) in vec3 in_vert_normal;
+layout (location = 0) out vec4 out_color;
+
+void main() {
+    vec3 light_dir = normalize(vec3(0.3, 1, 0.2));
+    float shade = 0.2 + 0.8 * max(dot(normalize(in_vert_normal), light_dir), 0);
+    out_color = vec4(vec3(shade), 1);
+}
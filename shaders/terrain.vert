@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// x: grid x, y: grid z, z: normalized height, w: octahedral-encoded normal
+layout (location = 0) in uvec4 in_vert;
+layout (location = 0) out vec3 out_vert_normal;
+
+layout (push_constant) uniform Push {
+    mat4 mvp_matrix;
+    float grid_spacing;
+    float height_scale;
+} push;
+
+vec3 decode_octahedral_normal(uint encoded) {
+    vec2 e = (vec2(encoded & 0xFF, encoded >> 8) / 255.0) * 2.0 - 1.0;
+    vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+
+    // Unfold lower hemisphere.
+    if (n.z < 0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0 ? 1.0 : -1.0, n.y >= 0 ? 1.0 : -1.0);
+
+    return normalize(n);
+}
+
+void main() {
+    vec3 position = vec3(float(in_vert.x) * push.grid_spacing,
+                         (float(in_vert.z) / 65535.0) * push.height_scale,
+                         float(in_vert.y) * push.grid_spacing);
+
+    gl_Position = push.mvp_matrix * vec4(position, 1);
+    out_vert_normal = decode_octahedral_normal(in_vert.w);
+}
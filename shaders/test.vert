@@ -4,11 +4,11 @@
 layout (location = 0) in vec3 in_vert_pos;
 layout (location = 0) out vec3 out_vert_pos;
 
-layout (push_constant) uniform Push {
-    mat4 mvp_matrix;
-} push;
+layout (set = 0, binding = 0) readonly buffer Instances {
+    mat4 mvp_matrixes[];
+} instances;
 
 void main() {
-    gl_Position = push.mvp_matrix * vec4(in_vert_pos, 1);
+    gl_Position = instances.mvp_matrixes[gl_InstanceIndex] * vec4(in_vert_pos, 1);
     out_vert_pos = in_vert_pos;
 }
@@ -4,8 +4,20 @@
 layout (location = 0) in vec2 in_vert_uv;
 layout (location = 0) out vec4 out_color;
 
-layout (set = 0, binding = 0) uniform sampler2D tex;
+layout (set = 1, binding = 0) uniform sampler2D tex;
+layout (set = 1, binding = 1) uniform sampler1D palette;
+
+// Set for single-channel display formats, whose values are mapped to color through the palette.
+layout (constant_id = 0) const bool USE_PALETTE = false;
 
 void main() {
-    out_color = texture(tex, in_vert_uv);
+    if (USE_PALETTE) {
+        // Sample at entry centers so 0 and 1 map exactly to the first and last palette entries.
+        float palette_size = float(textureSize(palette, 0));
+        float value = clamp(texture(tex, in_vert_uv).r, 0.0, 1.0);
+        out_color = texture(palette, (value * (palette_size - 1.0) + 0.5) / palette_size);
+    }
+    else {
+        out_color = texture(tex, in_vert_uv);
+    }
 }
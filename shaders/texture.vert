@@ -5,11 +5,11 @@ layout (location = 0) in vec3 in_vert_pos;
 layout (location = 1) in vec2 in_vert_uv;
 layout (location = 0) out vec2 out_vert_uv;
 
-layout (push_constant) uniform Push {
-    mat4 mvp_matrix;
-} push;
+layout (set = 0, binding = 0) readonly buffer Instances {
+    mat4 mvp_matrixes[];
+} instances;
 
 void main() {
-    gl_Position = push.mvp_matrix * vec4(in_vert_pos, 1);
+    gl_Position = instances.mvp_matrixes[gl_InstanceIndex] * vec4(in_vert_pos, 1);
     out_vert_uv = in_vert_uv;
 }
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string.h>
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 RADIX_BITS = 8;
+static constexpr u32 RADIX_SIZE = 1 << RADIX_BITS;
+static constexpr u32 RADIX_PASSES = 64 / RADIX_BITS;
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+
+// Stable LSD radix sort of 64-bit keys, moving values along with them. Histograms for every digit are built in one
+// read of the keys, and passes where all keys share a digit are skipped, so keys packed from a few small fields only
+// pay for the digits that actually vary.
+static void radix_sort(Memory *temp_mem, u64 *keys, u32 *values, u32 count) {
+    if (count < 2)
+        return;
+
+    push_frame(temp_mem);
+
+    u32 *histograms = allocate<u32>(temp_mem, RADIX_PASSES * RADIX_SIZE);
+    memset(histograms, 0, RADIX_PASSES * RADIX_SIZE * sizeof(u32));
+
+    for (u32 i = 0; i < count; ++i) {
+        u64 key = keys[i];
+        for (u32 pass = 0; pass < RADIX_PASSES; ++pass)
+            ++histograms[(pass * RADIX_SIZE) + ((key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1))];
+    }
+
+    u64 *src_keys = keys;
+    u32 *src_values = values;
+    u64 *dst_keys = allocate<u64>(temp_mem, count);
+    u32 *dst_values = allocate<u32>(temp_mem, count);
+
+    for (u32 pass = 0; pass < RADIX_PASSES; ++pass) {
+        u32 *histogram = histograms + (pass * RADIX_SIZE);
+        u32 shift = pass * RADIX_BITS;
+
+        // Every key has the same digit; order is unchanged.
+        if (histogram[(src_keys[0] >> shift) & (RADIX_SIZE - 1)] == count)
+            continue;
+
+        // Convert digit counts to output offsets.
+        u32 offset = 0;
+        for (u32 digit = 0; digit < RADIX_SIZE; ++digit) {
+            u32 digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+
+        for (u32 i = 0; i < count; ++i) {
+            u32 dst = histogram[(src_keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+            dst_keys[dst] = src_keys[i];
+            dst_values[dst] = src_values[i];
+        }
+
+        u64 *swap_keys = src_keys;
+        src_keys = dst_keys;
+        dst_keys = swap_keys;
+
+        u32 *swap_values = src_values;
+        src_values = dst_values;
+        dst_values = swap_values;
+    }
+
+    // Odd number of passes ran; results are in the temp arrays.
+    if (src_keys != keys) {
+        memcpy(keys, src_keys, count * sizeof(u64));
+        memcpy(values, src_values, count * sizeof(u32));
+    }
+
+    pop_frame(temp_mem);
+}
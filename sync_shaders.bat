@@ -2,7 +2,7 @@
 
 del assets\shaders\*.spv
 
-for /r %%v in (assets\shaders\*.vert,assets\shaders\*.frag) do (
+for /r %%v in (assets\shaders\*.vert,assets\shaders\*.frag,assets\shaders\*.comp) do (
     %VULKAN_SDK%\Bin\glslc.exe %%v -o %%v.spv
     echo compiled %%~nxv to %%~nxv.spv
 )
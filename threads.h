@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "ctk/ctk.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 MAX_WORKER_THREADS = 64;
+
+struct ParallelJob {
+    void (*run_task)(void *context, u32 task_idx);
+    void *context;
+    u32 task_count;
+    std::atomic<u32> next_task_idx;
+};
+
+// Threads started once by start_worker_threads() and woken for each parallel_for(). The calling thread works as one
+// of the workers, so thread_count - 1 threads are started.
+struct WorkerPool {
+    std::thread threads[MAX_WORKER_THREADS];
+    u32 thread_count;
+
+    std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+    ParallelJob *job;
+    u64 job_id;
+    u32 busy_worker_count;
+    bool stopping;
+};
+
+static WorkerPool worker_pool;
+
+// Set on pool threads and on the calling thread while it runs a job, so nested parallel_for() calls run serially
+// instead of waiting on workers that are busy with the outer job.
+static thread_local bool running_parallel_job;
+
+////////////////////////////////////////////////////////////
+/// Utils
+////////////////////////////////////////////////////////////
+static void run_parallel_tasks(ParallelJob *job) {
+    for (u32 task_idx = job->next_task_idx++; task_idx < job->task_count; task_idx = job->next_task_idx++)
+        job->run_task(job->context, task_idx);
+}
+
+static void run_worker(WorkerPool *pool) {
+    running_parallel_job = true;
+    u64 last_job_id = 0;
+
+    while (1) {
+        ParallelJob *job = NULL;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->job_ready.wait(lock, [&]() { return pool->stopping || pool->job_id != last_job_id; });
+            if (pool->stopping)
+                return;
+
+            last_job_id = pool->job_id;
+            job = pool->job;
+        }
+
+        run_parallel_tasks(job);
+
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            --pool->busy_worker_count;
+            if (pool->busy_worker_count == 0)
+                pool->job_done.notify_one();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static u32 worker_thread_count() {
+    u32 hardware_thread_count = std::thread::hardware_concurrency();
+    return clamp(hardware_thread_count, 1u, MAX_WORKER_THREADS);
+}
+
+static void start_worker_threads() {
+    WorkerPool *pool = &worker_pool;
+    CTK_ASSERT(pool->thread_count == 0);
+
+    pool->thread_count = worker_thread_count();
+    pool->job = NULL;
+    pool->job_id = 0;
+    pool->busy_worker_count = 0;
+    pool->stopping = false;
+
+    for (u32 i = 1; i < pool->thread_count; ++i)
+        pool->threads[i] = std::thread(run_worker, pool);
+}
+
+static void stop_worker_threads() {
+    WorkerPool *pool = &worker_pool;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stopping = true;
+    }
+    pool->job_ready.notify_all();
+
+    for (u32 i = 1; i < pool->thread_count; ++i)
+        pool->threads[i].join();
+
+    pool->thread_count = 0;
+}
+
+// Calls func(task_idx) for each task in [0, task_count) across the worker pool and returns once all tasks are done.
+// Tasks are handed out one at a time, so uneven tasks still balance. The calling thread works as one of the workers.
+// Only one thread may call parallel_for() at a time; calls from inside a task run serially on that task's thread.
+template<typename Func>
+static void parallel_for(u32 task_count, Func func) {
+    WorkerPool *pool = &worker_pool;
+
+    if (task_count <= 1 || pool->thread_count <= 1 || running_parallel_job) {
+        for (u32 task_idx = 0; task_idx < task_count; ++task_idx)
+            func(task_idx);
+
+        return;
+    }
+
+    ParallelJob job = {};
+    job.run_task = [](void *context, u32 task_idx) { (*(Func *)context)(task_idx); };
+    job.context = &func;
+    job.task_count = task_count;
+    job.next_task_idx = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->job = &job;
+        ++pool->job_id;
+        pool->busy_worker_count = pool->thread_count - 1;
+    }
+    pool->job_ready.notify_all();
+
+    running_parallel_job = true;
+    run_parallel_tasks(&job);
+    running_parallel_job = false;
+
+    // Every worker must be done with the job before it goes out of scope.
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->job_done.wait(lock, [&]() { return pool->busy_worker_count == 0; });
+    pool->job = NULL;
+}
@@ -48,6 +48,7 @@ struct Instance {
 struct QueueFamilyIndexes {
     u32 graphics;
     u32 present;
+    u32 transfer; // Dedicated transfer family (no graphics or compute), or U32_MAX if the device has none.
 };
 
 struct PhysicalDevice {
@@ -71,11 +72,17 @@ struct Swapchain {
     VkExtent2D extent;
 };
 
+static constexpr u32 MAX_BUFFER_QUEUE_FAMILIES = 4;
+
 struct BufferInfo {
     VkDeviceSize size;
     VkSharingMode sharing_mode;
     VkBufferUsageFlags usage_flags;
     VkMemoryPropertyFlags mem_property_flags;
+
+    // Families the buffer is shared between; only used if sharing_mode is VK_SHARING_MODE_CONCURRENT.
+    u32 queue_family_idxs[MAX_BUFFER_QUEUE_FAMILIES];
+    u32 queue_family_idx_count;
 };
 
 struct Buffer {
@@ -141,6 +148,7 @@ struct DescriptorPoolInfo {
     struct {
         u32 uniform_buffer;
         u32 uniform_buffer_dynamic;
+        u32 storage_buffer;
         u32 combined_image_sampler;
         u32 input_attachment;
     } descriptor_count;
@@ -182,6 +190,19 @@ struct ImageMemoryBarrier {
     VkImageSubresourceRange subresource_range;
 };
 
+struct BufferMemoryInfo {
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    u32 queue_family_index;
+};
+
+struct BufferMemoryBarrier {
+    BufferMemoryInfo src;
+    BufferMemoryInfo dst;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+};
+
 static constexpr VkPipelineColorBlendAttachmentState DEFAULT_COLOR_BLEND_ATTACHMENT = {
     .blendEnable = VK_FALSE,
     .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
@@ -323,7 +344,7 @@ static VkSurfaceKHR create_win32_surface(Instance *instance, HWND win32_window,
 static QueueFamilyIndexes find_queue_family_idxs(Memory temp_mem, VkPhysicalDevice physical_device,
                                                  VkSurfaceKHR surface)
 {
-    QueueFamilyIndexes queue_family_idxs = { .graphics = U32_MAX, .present = U32_MAX };
+    QueueFamilyIndexes queue_family_idxs = { .graphics = U32_MAX, .present = U32_MAX, .transfer = U32_MAX };
     auto queue_family_props_array =
         load_vk_objects<VkQueueFamilyProperties>(&temp_mem, vkGetPhysicalDeviceQueueFamilyProperties,
                                                  physical_device);
@@ -331,8 +352,19 @@ static QueueFamilyIndexes find_queue_family_idxs(Memory temp_mem, VkPhysicalDevi
     for (u32 queue_family_idx = 0; queue_family_idx < queue_family_props_array->count; ++queue_family_idx) {
         VkQueueFamilyProperties *queue_family_props = queue_family_props_array->data + queue_family_idx;
 
-        if (queue_family_props->queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        // Graphics family also runs compute passes recorded into render command buffers.
+        if ((queue_family_props->queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+            (queue_family_props->queueFlags & VK_QUEUE_COMPUTE_BIT))
+        {
             queue_family_idxs.graphics = queue_family_idx;
+        }
+
+        // Transfer-only families are usually backed by copy engines that run alongside graphics work.
+        if ((queue_family_props->queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            !(queue_family_props->queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            queue_family_idxs.transfer = queue_family_idx;
+        }
 
         VkBool32 present_supported = VK_FALSE;
         vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, queue_family_idx, surface, &present_supported);
@@ -415,9 +447,10 @@ static PhysicalDevice *create_physical_device(Memory temp_mem, PhysicalDevice *p
         curr_physical_device->depth_image_format = find_depth_image_format(curr_physical_device);
     }
 
-    // Sort out discrete and integrated gpus.
+    // Sort out discrete and integrated gpus from other devices (e.g. software implementations like lavapipe).
     auto discrete_devices = create_array<PhysicalDevice *>(&temp_mem, physical_devices->count);
     auto integrated_devices = create_array<PhysicalDevice *>(&temp_mem, physical_devices->count);
+    auto other_devices = create_array<PhysicalDevice *>(&temp_mem, physical_devices->count);
 
     for (u32 i = 0; i < physical_devices->count; ++i) {
         PhysicalDevice *curr_physical_device = physical_devices->data + i;
@@ -426,15 +459,22 @@ static PhysicalDevice *create_physical_device(Memory temp_mem, PhysicalDevice *p
             push(discrete_devices, curr_physical_device);
         else if (curr_physical_device->type == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU)
             push(integrated_devices, curr_physical_device);
+        else
+            push(other_devices, curr_physical_device);
     }
 
-    // Find suitable discrete device, or fallback to an integrated device.
+    // Find suitable discrete device, or fallback to an integrated device, then any other device.
     PhysicalDevice *suitable_device = find_suitable_physical_device(temp_mem, discrete_devices, requested_features,
                                                                     requested_feature_count);
 
     if (suitable_device == NULL) {
         suitable_device = find_suitable_physical_device(temp_mem, integrated_devices, requested_features,
                                                         requested_feature_count);
+    }
+
+    if (suitable_device == NULL) {
+        suitable_device = find_suitable_physical_device(temp_mem, other_devices, requested_features,
+                                                        requested_feature_count);
 
         if (suitable_device == NULL)
             CTK_FATAL("failed to find any suitable device");
@@ -461,12 +501,16 @@ static VkDeviceQueueCreateInfo default_queue_info(u32 queue_fam_idx) {
 static VkDevice create_device(PhysicalDevice *physical_device, PhysicalDeviceFeature *requested_features,
                               u32 requested_feature_count)
 {
-    FixedArray<VkDeviceQueueCreateInfo, 2> queue_infos = {};
-    push(&queue_infos, default_queue_info(physical_device->queue_family_idxs.graphics));
+    QueueFamilyIndexes *queue_family_idxs = &physical_device->queue_family_idxs;
+    FixedArray<VkDeviceQueueCreateInfo, 3> queue_infos = {};
+    push(&queue_infos, default_queue_info(queue_family_idxs->graphics));
 
     // Don't create separate queues if present and vk belong to same queue family.
-    if (physical_device->queue_family_idxs.present != physical_device->queue_family_idxs.graphics)
-        push(&queue_infos, default_queue_info(physical_device->queue_family_idxs.present));
+    if (queue_family_idxs->present != queue_family_idxs->graphics)
+        push(&queue_infos, default_queue_info(queue_family_idxs->present));
+
+    if (queue_family_idxs->transfer != U32_MAX && queue_family_idxs->transfer != queue_family_idxs->present)
+        push(&queue_infos, default_queue_info(queue_family_idxs->transfer));
 
     cstr extensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     VkBool32 enabled_features[(s32)PhysicalDeviceFeature::COUNT] = {};
@@ -673,8 +717,16 @@ static Buffer *create_buffer(Buffer *buffer, VkDevice device, PhysicalDevice *ph
     create_info.size = info.size;
     create_info.usage = info.usage_flags;
     create_info.sharingMode = info.sharing_mode;
-    create_info.queueFamilyIndexCount = 0;
-    create_info.pQueueFamilyIndices = NULL; // Ignored if sharingMode is not VK_SHARING_MODE_CONCURRENT.
+
+    if (info.sharing_mode == VK_SHARING_MODE_CONCURRENT) {
+        CTK_ASSERT(info.queue_family_idx_count >= 2 && info.queue_family_idx_count <= MAX_BUFFER_QUEUE_FAMILIES);
+        create_info.queueFamilyIndexCount = info.queue_family_idx_count;
+        create_info.pQueueFamilyIndices = info.queue_family_idxs;
+    }
+    else {
+        create_info.queueFamilyIndexCount = 0;
+        create_info.pQueueFamilyIndices = NULL;
+    }
     validate(vkCreateBuffer(device, &create_info, NULL, &buffer->handle), "failed to create buffer");
 
     // Allocate / Bind Memory
@@ -735,6 +787,13 @@ static Buffer *create_buffer(Buffer *buffer, VkDevice device, PhysicalDevice *ph
 //     vkCmdCopyBuffer(cmd_buf, staging_region->buffer->handle, region->buffer->handle, 1, &copy);
 // }
 
+// Maps all of a host-visible buffer's memory. Mappings stay valid until the memory is unmapped or freed.
+static void *map_buffer(VkDevice device, Buffer *buffer) {
+    void *mapped_mem = NULL;
+    validate(vkMapMemory(device, buffer->mem, 0, VK_WHOLE_SIZE, 0, &mapped_mem), "failed to map buffer memory");
+    return mapped_mem;
+}
+
 static void write_to_buffer(VkDevice device, BufferWriteInfo info) {
     void *mapped_mem = NULL;
     vkMapMemory(device, info.buffer->mem, info.offset, info.size, 0, &mapped_mem);
@@ -779,7 +838,7 @@ static void image_memory_barrier(VkCommandBuffer cmd_buf, Image *image, ImageMem
     vk_image_memory_barrier.oldLayout = image_memory_barrier.src.layout;
     vk_image_memory_barrier.newLayout = image_memory_barrier.dst.layout;
     vk_image_memory_barrier.srcQueueFamilyIndex = image_memory_barrier.src.queue_family_index;
-    vk_image_memory_barrier.dstQueueFamilyIndex = image_memory_barrier.src.queue_family_index;
+    vk_image_memory_barrier.dstQueueFamilyIndex = image_memory_barrier.dst.queue_family_index;
     vk_image_memory_barrier.image = image->handle;
     vk_image_memory_barrier.subresourceRange = image_memory_barrier.subresource_range;
 
@@ -792,6 +851,31 @@ static void image_memory_barrier(VkCommandBuffer cmd_buf, Image *image, ImageMem
                          1, &vk_image_memory_barrier);  // Image Memory Barriers
 }
 
+static VkBufferMemoryBarrier create_buffer_memory_barrier(Buffer *buffer, BufferMemoryBarrier buffer_memory_barrier) {
+    VkBufferMemoryBarrier vk_buffer_memory_barrier = {};
+    vk_buffer_memory_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    vk_buffer_memory_barrier.srcAccessMask = buffer_memory_barrier.src.access;
+    vk_buffer_memory_barrier.dstAccessMask = buffer_memory_barrier.dst.access;
+    vk_buffer_memory_barrier.srcQueueFamilyIndex = buffer_memory_barrier.src.queue_family_index;
+    vk_buffer_memory_barrier.dstQueueFamilyIndex = buffer_memory_barrier.dst.queue_family_index;
+    vk_buffer_memory_barrier.buffer = buffer->handle;
+    vk_buffer_memory_barrier.offset = buffer_memory_barrier.offset;
+    vk_buffer_memory_barrier.size = buffer_memory_barrier.size;
+    return vk_buffer_memory_barrier;
+}
+
+static void buffer_memory_barrier(VkCommandBuffer cmd_buf, Buffer *buffer, BufferMemoryBarrier buffer_memory_barrier) {
+    VkBufferMemoryBarrier vk_buffer_memory_barrier = create_buffer_memory_barrier(buffer, buffer_memory_barrier);
+
+    vkCmdPipelineBarrier(cmd_buf,
+                         buffer_memory_barrier.src.stage,
+                         buffer_memory_barrier.dst.stage,
+                         0,                             // Dependency Flags
+                         0, NULL,                       // Memory Barriers
+                         1, &vk_buffer_memory_barrier,  // Buffer Memory Barriers
+                         0, NULL);                      // Image Memory Barriers
+}
+
 static void copy_to_image(VkCommandBuffer cmd_buf, Buffer *buffer, u32 offset, Image *image) {
     image_memory_barrier(cmd_buf, image, {
         .src = {
@@ -852,6 +936,55 @@ static void copy_to_image(VkCommandBuffer cmd_buf, Buffer *buffer, u32 offset, I
     });
 }
 
+// Copies regions of buffer into an image that is in shader-read layout, keeping the rest of its contents. Region
+// buffer offsets and row lengths are expected to be filled in by the caller.
+static void copy_regions_to_image(VkCommandBuffer cmd_buf, Buffer *buffer, Image *image, VkBufferImageCopy *copies,
+                                  u32 copy_count)
+{
+    VkImageSubresourceRange subresource_range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+
+    image_memory_barrier(cmd_buf, image, {
+        .src = {
+            .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .access = VK_ACCESS_SHADER_READ_BIT,
+            .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        },
+        .dst = {
+            .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        },
+        .subresource_range = subresource_range,
+    });
+
+    vkCmdCopyBufferToImage(cmd_buf, buffer->handle, image->handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy_count,
+                           copies);
+
+    image_memory_barrier(cmd_buf, image, {
+        .src = {
+            .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        },
+        .dst = {
+            .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .access = VK_ACCESS_SHADER_READ_BIT,
+            .queue_family_index = VK_QUEUE_FAMILY_IGNORED,
+        },
+        .subresource_range = subresource_range,
+    });
+}
+
 static VkSampler create_sampler(VkDevice device, VkSamplerCreateInfo info) {
     VkSampler sampler = VK_NULL_HANDLE;
     validate(vkCreateSampler(device, &info, NULL, &sampler), "failed to create sampler");
@@ -928,7 +1061,7 @@ static RenderPass *create_render_pass(Memory temp_mem, Memory *perm_mem, RenderP
 }
 
 static VkDescriptorPool create_descriptor_pool(VkDevice device, DescriptorPoolInfo info) {
-    FixedArray<VkDescriptorPoolSize, 4> pool_sizes = {};
+    FixedArray<VkDescriptorPoolSize, 5> pool_sizes = {};
 
     if (info.descriptor_count.uniform_buffer) {
         push(&pool_sizes, {
@@ -944,6 +1077,13 @@ static VkDescriptorPool create_descriptor_pool(VkDevice device, DescriptorPoolIn
         });
     }
 
+    if (info.descriptor_count.storage_buffer) {
+        push(&pool_sizes, {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = info.descriptor_count.storage_buffer,
+        });
+    }
+
     if (info.descriptor_count.combined_image_sampler) {
         push(&pool_sizes, {
             .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
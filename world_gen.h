@@ -1,23 +1,17 @@
 #pragma once
 
 #include <math.h>
+#include <string.h>
 #include "ctk/ctk.h"
 #include "ctk/memory.h"
 #include "ctk/containers.h"
+#include "ctk/math.h"
+#include "noise_test/interp.h"
+#include "noise_test/permutation.h"
+#include "noise_test/threads.h"
 
 using namespace ctk;
 
-static constexpr int PERMUTATION[] = {
-    151,160,137,91,90,15,131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,190,6,148,247,120,
-    234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,88,237,149,56,87,174,20,125,136,171,168,68,175,74,165,71,
-    134,139,48,27,166,77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,102,143,54,65,25,63,
-    161,1,216,80,73,209,76,132,187,208,89,18,169,200,196,135,130,116,188,159,86,164,100,109,198,173,186,3,64,52,217,226,
-    250,124,123,5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,223,183,170,213,119,248,152,
-    2,44,154,163,70,221,153,101,155,167,43,172,9,129,22,39,253,19,98,108,110,79,113,224,232,178,185,112,104,218,246,97,
-    228,251,34,242,193,238,210,144,12,191,179,162,241,81,51,145,235,249,14,239,107,49,192,214,31,181,199,106,157,184,84,
-    204,176,115,121,50,45,127,4,150,254,138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180
-};
-
 // static constexpr Vec3<f64> UNIT_CUBE_CENTER_EDGE_VECTORS[] = {
 //     {  1, 1, 0 }, { -1, 1, 0 }, {  1,-1, 0 }, { -1,-1, 0 }, // XY Edges
 //     {  1, 0, 1 }, { -1, 0, 1 }, {  1, 0,-1 }, { -1, 0,-1 }, // XZ Edges
@@ -60,6 +54,1248 @@ static f64 noise(Vec2<f64> input) {
     return 0;
 }
 
+////////////////////////////////////////////////////////////
+/// Heightfield
+////////////////////////////////////////////////////////////
+
+// Row-major grid of cell heights. Other per-cell data, like hydrology flow, is kept in separate arrays of its own.
+struct Heightfield {
+    u32 width;
+    u32 depth;
+    f32 *height;
+};
+
+static Heightfield *create_heightfield(Memory *mem, u32 width, u32 depth) {
+    auto heightfield = allocate<Heightfield>(mem, 1);
+    heightfield->width = width;
+    heightfield->depth = depth;
+    heightfield->height = allocate<f32>(mem, width * depth);
+    return heightfield;
+}
+
+// Small per-task generator so parallel stages don't share random state and stay deterministic for any thread count.
+static u32 next_random(u32 *state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static f32 next_random_f32(u32 *state) {
+    return (next_random(state) >> 8) * (1.0f / (1 << 24));
+}
+
+////////////////////////////////////////////////////////////
+/// Hydraulic Erosion
+////////////////////////////////////////////////////////////
+struct HydraulicErosionInfo {
+    u32 droplet_count;
+    u32 max_droplet_lifetime;
+    f32 inertia;
+    f32 sediment_capacity_factor;
+    f32 min_sediment_capacity;
+    f32 erode_speed;
+    f32 deposit_speed;
+    f32 evaporate_speed;
+    f32 gravity;
+    f32 initial_water;
+    f32 initial_speed;
+    u32 tile_size;
+    u32 seed;
+};
+
+static constexpr HydraulicErosionInfo DEFAULT_HYDRAULIC_EROSION_INFO = {
+    .droplet_count = 1000000,
+    .max_droplet_lifetime = 30,
+    .inertia = 0.05f,
+    .sediment_capacity_factor = 4.0f,
+    .min_sediment_capacity = 0.01f,
+    .erode_speed = 0.3f,
+    .deposit_speed = 0.3f,
+    .evaporate_speed = 0.01f,
+    .gravity = 4.0f,
+    .initial_water = 1.0f,
+    .initial_speed = 1.0f,
+    .tile_size = 256,
+    .seed = 0xDEADBEEF,
+};
+
+// Cells a droplet is allowed to touch: its spawn tile grown by a margin on every side.
+struct ErosionRegion {
+    s32 min_x;
+    s32 min_z;
+    s32 max_x;
+    s32 max_z;
+};
+
+struct HeightAndGradient {
+    f32 height;
+    f32 gradient_x;
+    f32 gradient_z;
+};
+
+static HeightAndGradient height_and_gradient(Heightfield *heightfield, f32 x, f32 z) {
+    u32 cell_x = (u32)x;
+    u32 cell_z = (u32)z;
+    f32 u = x - cell_x;
+    f32 v = z - cell_z;
+
+    f32 *nw = heightfield->height + (cell_z * heightfield->width) + cell_x;
+    f32 h_nw = nw[0];
+    f32 h_ne = nw[1];
+    f32 h_sw = nw[heightfield->width];
+    f32 h_se = nw[heightfield->width + 1];
+
+    return {
+        .height = (h_nw * (1 - u) * (1 - v)) + (h_ne * u * (1 - v)) + (h_sw * (1 - u) * v) + (h_se * u * v),
+        .gradient_x = ((h_ne - h_nw) * (1 - v)) + ((h_se - h_sw) * v),
+        .gradient_z = ((h_sw - h_nw) * (1 - u)) + ((h_se - h_ne) * u),
+    };
+}
+
+// Adds amount (negative to erode) to the 4 cells around (x, z), weighted bilinearly.
+static void add_bilinear(Heightfield *heightfield, f32 x, f32 z, f32 amount) {
+    u32 cell_x = (u32)x;
+    u32 cell_z = (u32)z;
+    f32 u = x - cell_x;
+    f32 v = z - cell_z;
+
+    f32 *nw = heightfield->height + (cell_z * heightfield->width) + cell_x;
+    nw[0] += amount * (1 - u) * (1 - v);
+    nw[1] += amount * u * (1 - v);
+    nw[heightfield->width] += amount * (1 - u) * v;
+    nw[heightfield->width + 1] += amount * u * v;
+}
+
+static bool in_region(ErosionRegion *region, f32 x, f32 z) {
+    // Droplet touches cell and its +1 neighbors, so both must be inside region.
+    return x >= region->min_x && z >= region->min_z && x < region->max_x - 1 && z < region->max_z - 1;
+}
+
+static void simulate_droplet(Heightfield *heightfield, HydraulicErosionInfo *info, ErosionRegion *region,
+                             f32 x, f32 z)
+{
+    f32 dir_x = 0;
+    f32 dir_z = 0;
+    f32 speed = info->initial_speed;
+    f32 water = info->initial_water;
+    f32 sediment = 0;
+
+    for (u32 lifetime = 0; lifetime < info->max_droplet_lifetime; ++lifetime) {
+        HeightAndGradient start = height_and_gradient(heightfield, x, z);
+
+        // Blend previous direction with downhill direction, then step one cell.
+        dir_x = (dir_x * info->inertia) - (start.gradient_x * (1 - info->inertia));
+        dir_z = (dir_z * info->inertia) - (start.gradient_z * (1 - info->inertia));
+        f32 dir_length = sqrtf((dir_x * dir_x) + (dir_z * dir_z));
+
+        // Droplet is stuck in a flat spot.
+        if (dir_length == 0)
+            break;
+
+        dir_x /= dir_length;
+        dir_z /= dir_length;
+
+        f32 prev_x = x;
+        f32 prev_z = z;
+        x += dir_x;
+        z += dir_z;
+
+        // Stop at last position inside region if droplet leaves it.
+        if (!in_region(region, x, z)) {
+            x = prev_x;
+            z = prev_z;
+            break;
+        }
+
+        f32 delta_height = height_and_gradient(heightfield, x, z).height - start.height;
+        f32 sediment_capacity = max(-delta_height * speed * water * info->sediment_capacity_factor,
+                                    info->min_sediment_capacity);
+
+        if (sediment > sediment_capacity || delta_height > 0) {
+            // Moving uphill fills the pit behind it; otherwise drop a fraction of excess sediment.
+            f32 deposit = delta_height > 0
+                          ? min(delta_height, sediment)
+                          : (sediment - sediment_capacity) * info->deposit_speed;
+            sediment -= deposit;
+            add_bilinear(heightfield, prev_x, prev_z, deposit);
+        }
+        else {
+            // Never erode more than the height difference so droplets don't dig holes.
+            f32 erode = min((sediment_capacity - sediment) * info->erode_speed, -delta_height);
+            sediment += erode;
+            add_bilinear(heightfield, prev_x, prev_z, -erode);
+        }
+
+        speed = sqrtf(max((speed * speed) - (delta_height * info->gravity), 0.0f));
+        water *= 1 - info->evaporate_speed;
+    }
+
+    // Drop any sediment still carried so erosion conserves material.
+    add_bilinear(heightfield, x, z, sediment);
+}
+
+// Particle-based hydraulic erosion. The map is cut into tiles that are processed in 4 phases of a 2x2 checkerboard;
+// each droplet spawns in a tile and may only travel half a tile past its edges, so tiles in the same phase never touch
+// the same cells and run in parallel without locks. Changes that spill across a seam are picked up by the neighboring
+// tiles' droplets in later phases.
+static void hydraulic_erosion(Heightfield *heightfield, HydraulicErosionInfo info) {
+    CTK_ASSERT(info.tile_size >= 4);
+    CTK_ASSERT(heightfield->width >= 2 && heightfield->depth >= 2);
+
+    u32 tile_count_x = (heightfield->width + info.tile_size - 1) / info.tile_size;
+    u32 tile_count_z = (heightfield->depth + info.tile_size - 1) / info.tile_size;
+    u32 tile_count = tile_count_x * tile_count_z;
+    s32 margin = info.tile_size / 2;
+
+    for (u32 phase = 0; phase < 4; ++phase) {
+        u32 phase_x = phase & 1;
+        u32 phase_z = phase >> 1;
+        u32 phase_tile_count_x = (tile_count_x + 1 - phase_x) / 2;
+        u32 phase_tile_count_z = (tile_count_z + 1 - phase_z) / 2;
+
+        parallel_for(phase_tile_count_x * phase_tile_count_z, [&](u32 phase_tile_idx) {
+            u32 tile_x = ((phase_tile_idx % phase_tile_count_x) * 2) + phase_x;
+            u32 tile_z = ((phase_tile_idx / phase_tile_count_x) * 2) + phase_z;
+            u32 tile_idx = (tile_z * tile_count_x) + tile_x;
+
+            s32 tile_min_x = tile_x * info.tile_size;
+            s32 tile_min_z = tile_z * info.tile_size;
+            s32 tile_max_x = min(tile_min_x + (s32)info.tile_size, (s32)heightfield->width);
+            s32 tile_max_z = min(tile_min_z + (s32)info.tile_size, (s32)heightfield->depth);
+
+            ErosionRegion region = {
+                .min_x = max(tile_min_x - margin, 0),
+                .min_z = max(tile_min_z - margin, 0),
+                .max_x = min(tile_max_x + margin, (s32)heightfield->width),
+                .max_z = min(tile_max_z + margin, (s32)heightfield->depth),
+            };
+
+            // Spread droplets evenly over tiles, giving the remainder to the first tiles.
+            u32 droplet_count = (info.droplet_count / tile_count) + (tile_idx < info.droplet_count % tile_count);
+            u32 random_state = (info.seed ^ (tile_idx * 0x9E3779B9)) | 1;
+
+            for (u32 i = 0; i < droplet_count; ++i) {
+                f32 x = tile_min_x + (next_random_f32(&random_state) * (tile_max_x - tile_min_x - 1));
+                f32 z = tile_min_z + (next_random_f32(&random_state) * (tile_max_z - tile_min_z - 1));
+
+                if (in_region(&region, x, z))
+                    simulate_droplet(heightfield, &info, &region, x, z);
+            }
+        });
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Thermal Erosion
+////////////////////////////////////////////////////////////
+struct ThermalErosionInfo {
+    u32 iteration_count;
+    f32 talus; // Height difference between neighbors above which material slides.
+    f32 rate;  // Fraction of excess moved per iteration (stable up to 0.5).
+};
+
+static f32 thermal_transfer(f32 from, f32 to, f32 talus, f32 rate) {
+    return max(from - to - talus, 0.0f) * rate * 0.25f;
+}
+
+// Thermal erosion over 4-neighborhoods. Each cell's change is computed only from its own and its neighbors' previous
+// heights, so rows are independent and material is conserved exactly (every pairwise transfer is counted once out of
+// one cell and once into the other).
+static void thermal_erosion(Memory *temp_mem, Heightfield *heightfield, ThermalErosionInfo info) {
+    push_frame(temp_mem);
+
+    u32 width = heightfield->width;
+    u32 depth = heightfield->depth;
+    f32 *src = heightfield->height;
+    f32 *dst = allocate<f32>(temp_mem, width * depth);
+
+    for (u32 iteration = 0; iteration < info.iteration_count; ++iteration) {
+        parallel_for(depth, [&](u32 z) {
+            f32 *row = src + (z * width);
+            f32 *north = z > 0 ? row - width : row;
+            f32 *south = z < depth - 1 ? row + width : row;
+            f32 *dst_row = dst + (z * width);
+
+            for (u32 x = 0; x < width; ++x) {
+                f32 h = row[x];
+                f32 west = row[x > 0 ? x - 1 : x];
+                f32 east = row[x < width - 1 ? x + 1 : x];
+
+                // Edge cells compare against themselves, which transfers nothing.
+                f32 out = thermal_transfer(h, west, info.talus, info.rate) +
+                          thermal_transfer(h, east, info.talus, info.rate) +
+                          thermal_transfer(h, north[x], info.talus, info.rate) +
+                          thermal_transfer(h, south[x], info.talus, info.rate);
+                f32 in = thermal_transfer(west, h, info.talus, info.rate) +
+                         thermal_transfer(east, h, info.talus, info.rate) +
+                         thermal_transfer(north[x], h, info.talus, info.rate) +
+                         thermal_transfer(south[x], h, info.talus, info.rate);
+
+                dst_row[x] = h - out + in;
+            }
+        });
+
+        f32 *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    // Result ends in temp buffer after an odd number of iterations.
+    if (src != heightfield->height)
+        memcpy(heightfield->height, src, width * depth * sizeof(f32));
+
+    pop_frame(temp_mem);
+}
+
+////////////////////////////////////////////////////////////
+/// Hydrology
+////////////////////////////////////////////////////////////
+static constexpr u8 FLOW_NONE = 8; // Cell is a pit or drains off the map edge.
+static constexpr s32 FLOW_OFFSET_X[] = { 1, 1, 0, -1, -1, -1,  0,  1 };
+static constexpr s32 FLOW_OFFSET_Z[] = { 0, 1, 1,  1,  0, -1, -1, -1 };
+static constexpr f32 FLOW_DISTANCE[] = { 1, 1.41421356f, 1, 1.41421356f, 1, 1.41421356f, 1, 1.41421356f };
+
+// Depression filling labels every cell with the watershed it was flooded from. Cells on the map edge drain into the
+// ocean, which every other watershed eventually spills into.
+static constexpr u32 NO_LABEL = 0;
+static constexpr u32 OCEAN_LABEL = 1;
+
+struct HydrologyInfo {
+    u32 tile_size;
+    u32 river_threshold; // Upstream cell count at which a cell is marked as river.
+};
+
+static constexpr HydrologyInfo DEFAULT_HYDROLOGY_INFO = {
+    .tile_size = 512,
+    .river_threshold = 1000,
+};
+
+struct Hydrology {
+    u32 width;
+    u32 depth;
+    u8 *flow_dir;      // D8 direction index into FLOW_OFFSET_X/Z, or FLOW_NONE.
+    u32 *accumulation; // Number of cells draining through each cell, including itself.
+    u32 *watershed;    // Index of the cell each cell finally drains into.
+    u8 *river_mask;
+};
+
+// Tile cells are stored contiguously in per-tile scratch planes starting at cell_offset, which is the number of cells
+// in all tiles before this one in row-major tile order.
+struct HydrologyTile {
+    u32 min_x;
+    u32 min_z;
+    u32 max_x;
+    u32 max_z;
+    u32 cell_offset;
+};
+
+struct FloodNode {
+    f32 height;
+    u32 idx;
+};
+
+// Binary min-heap used by priority-flood.
+struct FloodQueue {
+    FloodNode *nodes;
+    u32 count;
+    u32 size;
+};
+
+// Lowest spill height found between two watershed labels (label_a < label_b), or label_a == NO_LABEL if unused.
+struct SpillEdge {
+    u32 label_a;
+    u32 label_b;
+    f32 height;
+};
+
+struct SpillEdgeTable {
+    SpillEdge *edges;
+    u32 count;
+    u32 size;
+};
+
+static Hydrology *create_hydrology(Memory *mem, u32 width, u32 depth) {
+    auto hydrology = allocate<Hydrology>(mem, 1);
+    hydrology->width = width;
+    hydrology->depth = depth;
+    hydrology->flow_dir = allocate<u8>(mem, width * depth);
+    hydrology->accumulation = allocate<u32>(mem, width * depth);
+    hydrology->watershed = allocate<u32>(mem, width * depth);
+    hydrology->river_mask = allocate<u8>(mem, width * depth);
+    return hydrology;
+}
+
+static HydrologyTile hydrology_tile(u32 width, u32 depth, u32 tile_size, u32 tile_idx) {
+    u32 tile_count_x = (width + tile_size - 1) / tile_size;
+    HydrologyTile tile = {};
+    tile.min_x = (tile_idx % tile_count_x) * tile_size;
+    tile.min_z = (tile_idx / tile_count_x) * tile_size;
+    tile.max_x = min(tile.min_x + tile_size, width);
+    tile.max_z = min(tile.min_z + tile_size, depth);
+    tile.cell_offset = (tile.min_z * width) + (tile.min_x * (tile.max_z - tile.min_z));
+    return tile;
+}
+
+static bool in_tile(HydrologyTile *tile, s32 x, s32 z) {
+    return x >= (s32)tile->min_x && z >= (s32)tile->min_z && x < (s32)tile->max_x && z < (s32)tile->max_z;
+}
+
+static bool on_map_edge(u32 width, u32 depth, u32 x, u32 z) {
+    return x == 0 || z == 0 || x == width - 1 || z == depth - 1;
+}
+
+static void push_flood_node(FloodQueue *queue, f32 height, u32 idx) {
+    CTK_ASSERT(queue->count < queue->size);
+
+    u32 node = queue->count++;
+    while (node > 0) {
+        u32 parent = (node - 1) / 2;
+        if (queue->nodes[parent].height <= height)
+            break;
+
+        queue->nodes[node] = queue->nodes[parent];
+        node = parent;
+    }
+
+    queue->nodes[node] = { height, idx };
+}
+
+static FloodNode pop_flood_node(FloodQueue *queue) {
+    CTK_ASSERT(queue->count > 0);
+
+    FloodNode top = queue->nodes[0];
+    FloodNode last = queue->nodes[--queue->count];
+
+    u32 node = 0;
+    for (;;) {
+        u32 child = (node * 2) + 1;
+        if (child >= queue->count)
+            break;
+
+        if (child + 1 < queue->count && queue->nodes[child + 1].height < queue->nodes[child].height)
+            ++child;
+
+        if (last.height <= queue->nodes[child].height)
+            break;
+
+        queue->nodes[node] = queue->nodes[child];
+        node = child;
+    }
+
+    queue->nodes[node] = last;
+    return top;
+}
+
+static void add_spill_edge(SpillEdgeTable *table, u32 label_a, u32 label_b, f32 height) {
+    if (label_a > label_b) {
+        u32 swap = label_a;
+        label_a = label_b;
+        label_b = swap;
+    }
+
+    // Open addressing; table size is a power of 2.
+    u32 mask = table->size - 1;
+    for (u32 slot = ((label_a * 0x9E3779B1) ^ (label_b * 0x85EBCA77)) & mask;; slot = (slot + 1) & mask) {
+        SpillEdge *edge = table->edges + slot;
+
+        if (edge->label_a == NO_LABEL) {
+            // Tables are kept at most half full so probe sequences stay short.
+            if (table->count == table->size / 2)
+                CTK_FATAL("cannot add spill edge: already at max spill edge count of %u", table->size / 2);
+
+            *edge = { label_a, label_b, height };
+            ++table->count;
+            return;
+        }
+
+        if (edge->label_a == label_a && edge->label_b == label_b) {
+            edge->height = min(edge->height, height);
+            return;
+        }
+    }
+}
+
+// Priority-flood (Barnes et al.) over one tile, treating its perimeter as outlets. Each perimeter cell that isn't
+// reached from a lower one starts a new watershed label; cells on the map edge belong to the ocean. Heights are
+// raised to their in-tile spill height, and the lowest spill between each pair of touching labels is recorded.
+static void flood_tile(Heightfield *heightfield, HydrologyTile *tile, u32 *labels, u32 first_label,
+                       FloodQueue *queue, SpillEdgeTable *edges)
+{
+    u32 width = heightfield->width;
+    u32 depth = heightfield->depth;
+    f32 *height = heightfield->height;
+
+    // Map edge cells are labeled up front so a flood from inside the tile can't claim them for another watershed.
+    queue->count = 0;
+    for (u32 z = tile->min_z; z < tile->max_z; ++z)
+    for (u32 x = tile->min_x; x < tile->max_x; ++x) {
+        u32 idx = (z * width) + x;
+        labels[idx] = on_map_edge(width, depth, x, z) ? OCEAN_LABEL : NO_LABEL;
+
+        if (x == tile->min_x || z == tile->min_z || x == tile->max_x - 1 || z == tile->max_z - 1)
+            push_flood_node(queue, height[idx], idx);
+    }
+
+    u32 next_label = first_label;
+    while (queue->count > 0) {
+        u32 idx = pop_flood_node(queue).idx;
+        u32 x = idx % width;
+        u32 z = idx / width;
+
+        if (labels[idx] == NO_LABEL)
+            labels[idx] = next_label++;
+
+        for (u32 dir = 0; dir < 8; ++dir) {
+            s32 neighbor_x = x + FLOW_OFFSET_X[dir];
+            s32 neighbor_z = z + FLOW_OFFSET_Z[dir];
+            if (!in_tile(tile, neighbor_x, neighbor_z))
+                continue;
+
+            u32 neighbor_idx = (neighbor_z * width) + neighbor_x;
+            if (labels[neighbor_idx] == NO_LABEL) {
+                labels[neighbor_idx] = labels[idx];
+                height[neighbor_idx] = max(height[neighbor_idx], height[idx]);
+                push_flood_node(queue, height[neighbor_idx], neighbor_idx);
+            }
+            else if (labels[neighbor_idx] != labels[idx]) {
+                add_spill_edge(edges, labels[idx], labels[neighbor_idx], max(height[idx], height[neighbor_idx]));
+            }
+        }
+    }
+}
+
+// Fills depressions so every cell has a non-ascending path to the map edge. Tiles are flooded in parallel, then the
+// small graph of watershed labels joined by spill heights (within tiles and across tile seams) is flooded from the
+// ocean to find each label's final water level, which is applied back to the tiles in parallel.
+static void fill_depressions(Memory *temp_mem, Heightfield *heightfield, u32 tile_size) {
+    CTK_ASSERT(tile_size >= 2);
+
+    push_frame(temp_mem);
+
+    u32 width = heightfield->width;
+    u32 depth = heightfield->depth;
+    f32 *height = heightfield->height;
+    u32 tile_count_x = (width + tile_size - 1) / tile_size;
+    u32 tile_count_z = (depth + tile_size - 1) / tile_size;
+    u32 tile_count = tile_count_x * tile_count_z;
+
+    // Only perimeter cells start labels.
+    u32 max_tile_labels = 4 * tile_size;
+    u32 label_count = OCEAN_LABEL + 1 + (tile_count * max_tile_labels);
+    u32 *labels = allocate<u32>(temp_mem, width * depth);
+
+    // Touching label pairs form a near-planar graph, so a few times the label count is plenty.
+    u32 edge_table_size = 1;
+    while (edge_table_size < max_tile_labels * 16)
+        edge_table_size *= 2;
+
+    auto edge_tables = allocate<SpillEdgeTable>(temp_mem, tile_count);
+    for (u32 tile_idx = 0; tile_idx < tile_count; ++tile_idx) {
+        edge_tables[tile_idx].edges = allocate<SpillEdge>(temp_mem, edge_table_size);
+        edge_tables[tile_idx].count = 0;
+        edge_tables[tile_idx].size = edge_table_size;
+        memset(edge_tables[tile_idx].edges, 0, edge_table_size * sizeof(SpillEdge));
+    }
+
+    // Tiles are flooded in batches of one per worker so only that many queues are needed. Every cell is pushed at
+    // most twice (once as perimeter, once when reached).
+    u32 batch_size = min(worker_thread_count(), tile_count);
+    auto queues = allocate<FloodQueue>(temp_mem, batch_size);
+    for (u32 i = 0; i < batch_size; ++i) {
+        queues[i].size = tile_size * tile_size * 2;
+        queues[i].nodes = allocate<FloodNode>(temp_mem, queues[i].size);
+    }
+
+    for (u32 batch_start = 0; batch_start < tile_count; batch_start += batch_size) {
+        parallel_for(min(batch_size, tile_count - batch_start), [&](u32 batch_idx) {
+            u32 tile_idx = batch_start + batch_idx;
+            HydrologyTile tile = hydrology_tile(width, depth, tile_size, tile_idx);
+            flood_tile(heightfield, &tile, labels, OCEAN_LABEL + 1 + (tile_idx * max_tile_labels), queues + batch_idx,
+                       edge_tables + tile_idx);
+        });
+    }
+
+    // Gather label graph: recorded in-tile edges plus every cell pair straddling a tile seam.
+    u32 seam_edge_count = ((tile_count_x - 1) * depth * 3) + ((tile_count_z - 1) * width * 3);
+    u32 max_edge_count = seam_edge_count;
+    for (u32 tile_idx = 0; tile_idx < tile_count; ++tile_idx)
+        max_edge_count += edge_tables[tile_idx].count;
+
+    SpillEdge *edges = allocate<SpillEdge>(temp_mem, max_edge_count);
+    u32 edge_count = 0;
+
+    for (u32 tile_idx = 0; tile_idx < tile_count; ++tile_idx) {
+        SpillEdgeTable *table = edge_tables + tile_idx;
+        for (u32 slot = 0; slot < table->size; ++slot) {
+            if (table->edges[slot].label_a != NO_LABEL)
+                edges[edge_count++] = table->edges[slot];
+        }
+    }
+
+    auto add_seam_edge = [&](u32 a, u32 b) {
+        if (labels[a] != labels[b])
+            edges[edge_count++] = { labels[a], labels[b], max(height[a], height[b]) };
+    };
+
+    for (u32 tile_x = 1; tile_x < tile_count_x; ++tile_x) {
+        u32 x = tile_x * tile_size;
+        for (u32 z = 0; z < depth; ++z) {
+            u32 idx = (z * width) + x;
+            if (z > 0)
+                add_seam_edge(idx - 1, idx - width);
+
+            add_seam_edge(idx - 1, idx);
+
+            if (z < depth - 1)
+                add_seam_edge(idx - 1, idx + width);
+        }
+    }
+
+    for (u32 tile_z = 1; tile_z < tile_count_z; ++tile_z) {
+        u32 z = tile_z * tile_size;
+        for (u32 x = 0; x < width; ++x) {
+            u32 idx = (z * width) + x;
+            if (x > 0)
+                add_seam_edge(idx - width, idx - 1);
+
+            add_seam_edge(idx - width, idx);
+
+            if (x < width - 1)
+                add_seam_edge(idx - width, idx + 1);
+        }
+    }
+
+    // Label adjacency in CSR form.
+    u32 *adjacency_offset = allocate<u32>(temp_mem, label_count + 1);
+    u32 *adjacency = allocate<u32>(temp_mem, edge_count * 2);
+    memset(adjacency_offset, 0, (label_count + 1) * sizeof(u32));
+
+    for (u32 i = 0; i < edge_count; ++i) {
+        ++adjacency_offset[edges[i].label_a + 1];
+        ++adjacency_offset[edges[i].label_b + 1];
+    }
+
+    for (u32 label = 0; label < label_count; ++label)
+        adjacency_offset[label + 1] += adjacency_offset[label];
+
+    {
+        u32 *fill = allocate<u32>(temp_mem, label_count);
+        memcpy(fill, adjacency_offset, label_count * sizeof(u32));
+
+        for (u32 i = 0; i < edge_count; ++i) {
+            adjacency[fill[edges[i].label_a]++] = i;
+            adjacency[fill[edges[i].label_b]++] = i;
+        }
+    }
+
+    // Flood label graph from the ocean; a label's water level is the lowest possible maximum spill height along any
+    // path to the ocean.
+    f32 *water_level = allocate<f32>(temp_mem, label_count);
+    bool *settled = allocate<bool>(temp_mem, label_count);
+    for (u32 label = 0; label < label_count; ++label) {
+        water_level[label] = INFINITY;
+        settled[label] = false;
+    }
+
+    FloodQueue label_queue = {};
+    label_queue.size = (edge_count * 2) + 1;
+    label_queue.nodes = allocate<FloodNode>(temp_mem, label_queue.size);
+    water_level[OCEAN_LABEL] = -INFINITY;
+    push_flood_node(&label_queue, -INFINITY, OCEAN_LABEL);
+
+    while (label_queue.count > 0) {
+        FloodNode node = pop_flood_node(&label_queue);
+        if (settled[node.idx])
+            continue;
+
+        settled[node.idx] = true;
+
+        for (u32 i = adjacency_offset[node.idx]; i < adjacency_offset[node.idx + 1]; ++i) {
+            SpillEdge *edge = edges + adjacency[i];
+            u32 neighbor = edge->label_a == node.idx ? edge->label_b : edge->label_a;
+            f32 level = max(node.height, edge->height);
+
+            if (!settled[neighbor] && level < water_level[neighbor]) {
+                water_level[neighbor] = level;
+                push_flood_node(&label_queue, level, neighbor);
+            }
+        }
+    }
+
+    parallel_for(depth, [&](u32 z) {
+        for (u32 idx = z * width; idx < (z + 1) * width; ++idx)
+            height[idx] = max(height[idx], water_level[labels[idx]]);
+    });
+
+    pop_frame(temp_mem);
+}
+
+// D8 flow directions on a depression-filled heightfield. Each cell flows to its steepest downhill neighbor; cells on
+// flats drain toward the nearest cell that already has a way out, found with a breadth-first search from flat edges.
+static void compute_flow_directions(Memory *temp_mem, Hydrology *hydrology, Heightfield *heightfield) {
+    CTK_ASSERT(hydrology->width == heightfield->width && hydrology->depth == heightfield->depth);
+
+    u32 width = heightfield->width;
+    u32 depth = heightfield->depth;
+    f32 *height = heightfield->height;
+    u8 *flow_dir = hydrology->flow_dir;
+
+    parallel_for(depth, [&](u32 z) {
+        for (u32 x = 0; x < width; ++x) {
+            u32 idx = (z * width) + x;
+            u8 best_dir = FLOW_NONE;
+            f32 best_slope = 0;
+
+            for (u32 dir = 0; dir < 8; ++dir) {
+                s32 neighbor_x = x + FLOW_OFFSET_X[dir];
+                s32 neighbor_z = z + FLOW_OFFSET_Z[dir];
+                if (neighbor_x < 0 || neighbor_z < 0 || neighbor_x >= (s32)width || neighbor_z >= (s32)depth)
+                    continue;
+
+                f32 slope = (height[idx] - height[(neighbor_z * width) + neighbor_x]) / FLOW_DISTANCE[dir];
+                if (slope > best_slope) {
+                    best_slope = slope;
+                    best_dir = dir;
+                }
+            }
+
+            flow_dir[idx] = best_dir;
+        }
+    });
+
+    push_frame(temp_mem);
+
+    // Map edge cells without a downhill neighbor drain off the map, so only interior cells are unresolved.
+    auto unresolved = [&](u32 x, u32 z) {
+        return flow_dir[(z * width) + x] == FLOW_NONE && !on_map_edge(width, depth, x, z);
+    };
+
+    u32 *queue = allocate<u32>(temp_mem, width * depth);
+    u32 queue_head = 0;
+    u32 queue_tail = 0;
+
+    for (u32 z = 1; z + 1 < depth; ++z)
+    for (u32 x = 1; x + 1 < width; ++x) {
+        if (!unresolved(x, z))
+            continue;
+
+        u32 idx = (z * width) + x;
+        for (u32 dir = 0; dir < 8; ++dir) {
+            u32 neighbor_x = x + FLOW_OFFSET_X[dir];
+            u32 neighbor_z = z + FLOW_OFFSET_Z[dir];
+            u32 neighbor_idx = (neighbor_z * width) + neighbor_x;
+
+            if (height[neighbor_idx] == height[idx] && !unresolved(neighbor_x, neighbor_z)) {
+                flow_dir[idx] = dir;
+                queue[queue_tail++] = idx;
+                break;
+            }
+        }
+    }
+
+    while (queue_head < queue_tail) {
+        u32 idx = queue[queue_head++];
+        u32 x = idx % width;
+        u32 z = idx / width;
+
+        for (u32 dir = 0; dir < 8; ++dir) {
+            u32 neighbor_x = x + FLOW_OFFSET_X[dir];
+            u32 neighbor_z = z + FLOW_OFFSET_Z[dir];
+            if (neighbor_x >= width || neighbor_z >= depth || !unresolved(neighbor_x, neighbor_z))
+                continue;
+
+            u32 neighbor_idx = (neighbor_z * width) + neighbor_x;
+            if (height[neighbor_idx] == height[idx]) {
+                flow_dir[neighbor_idx] = (dir + 4) % 8; // Point back at idx.
+                queue[queue_tail++] = neighbor_idx;
+            }
+        }
+    }
+
+    pop_frame(temp_mem);
+}
+
+static u32 flow_target(Hydrology *hydrology, u32 idx) {
+    u8 dir = hydrology->flow_dir[idx];
+    if (dir == FLOW_NONE)
+        return U32_MAX;
+
+    return idx + FLOW_OFFSET_X[dir] + (FLOW_OFFSET_Z[dir] * (s32)hydrology->width);
+}
+
+static bool flows_within_tile(Hydrology *hydrology, HydrologyTile *tile, u32 target) {
+    return target != U32_MAX && in_tile(tile, target % hydrology->width, target / hydrology->width);
+}
+
+// Flow accumulation in 3 steps (Barnes' parallel non-divergent scheme): each tile accumulates its own cells in
+// topological order and records, per cell, the last in-tile cell on its flow path (its exit); the small graph of
+// exits joined across tile seams is then accumulated serially; finally each tile pushes the flow entering across
+// its seams down its own paths in parallel. Watershed labels are resolved along the same steps.
+static void accumulate_flow(Memory *temp_mem, Hydrology *hydrology, u32 tile_size) {
+    push_frame(temp_mem);
+
+    u32 width = hydrology->width;
+    u32 depth = hydrology->depth;
+    u32 cell_count = width * depth;
+    u32 tile_count = ((width + tile_size - 1) / tile_size) * ((depth + tile_size - 1) / tile_size);
+    u32 *accumulation = hydrology->accumulation;
+    u32 *watershed = hydrology->watershed;
+
+    u8 *in_degree = allocate<u8>(temp_mem, cell_count);
+    u32 *order = allocate<u32>(temp_mem, cell_count);      // Per-tile topological order.
+    u32 *path_exit = allocate<u32>(temp_mem, cell_count);
+    u32 *exit_cells = allocate<u32>(temp_mem, cell_count); // Per-tile list of cells whose flow leaves the tile or ends.
+    u32 *inflow = allocate<u32>(temp_mem, cell_count);     // Flow entering a tile at a cell from across a seam.
+    u32 *exit_inflow = allocate<u32>(temp_mem, cell_count);
+    u32 *pending = allocate<u32>(temp_mem, cell_count);
+    u32 *tile_exit_count = allocate<u32>(temp_mem, tile_count);
+
+    // Tile-local accumulation.
+    parallel_for(tile_count, [&](u32 tile_idx) {
+        HydrologyTile tile = hydrology_tile(width, depth, tile_size, tile_idx);
+        u32 *tile_order = order + tile.cell_offset;
+        u32 *tile_exits = exit_cells + tile.cell_offset;
+        u32 order_count = 0;
+        u32 exit_count = 0;
+
+        for (u32 z = tile.min_z; z < tile.max_z; ++z)
+        for (u32 x = tile.min_x; x < tile.max_x; ++x) {
+            u32 idx = (z * width) + x;
+            in_degree[idx] = 0;
+            accumulation[idx] = 1;
+            inflow[idx] = 0;
+        }
+
+        for (u32 z = tile.min_z; z < tile.max_z; ++z)
+        for (u32 x = tile.min_x; x < tile.max_x; ++x) {
+            u32 target = flow_target(hydrology, (z * width) + x);
+            if (flows_within_tile(hydrology, &tile, target))
+                ++in_degree[target];
+        }
+
+        for (u32 z = tile.min_z; z < tile.max_z; ++z)
+        for (u32 x = tile.min_x; x < tile.max_x; ++x) {
+            u32 idx = (z * width) + x;
+            if (in_degree[idx] == 0)
+                tile_order[order_count++] = idx;
+        }
+
+        for (u32 i = 0; i < order_count; ++i) {
+            u32 idx = tile_order[i];
+            u32 target = flow_target(hydrology, idx);
+
+            if (flows_within_tile(hydrology, &tile, target)) {
+                accumulation[target] += accumulation[idx];
+                if (--in_degree[target] == 0)
+                    tile_order[order_count++] = target;
+            }
+        }
+
+        // Walk upstream so each cell's target already knows its exit.
+        for (u32 i = order_count; i-- > 0;) {
+            u32 idx = tile_order[i];
+            u32 target = flow_target(hydrology, idx);
+
+            if (flows_within_tile(hydrology, &tile, target)) {
+                path_exit[idx] = path_exit[target];
+            }
+            else {
+                path_exit[idx] = idx;
+                tile_exits[exit_count++] = idx;
+            }
+        }
+
+        tile_exit_count[tile_idx] = exit_count;
+    });
+
+    // Seam merge: exits form a DAG where each exit feeds the exit of the cell it flows into in the neighboring tile.
+    u32 total_exit_count = 0;
+    for (u32 tile_idx = 0; tile_idx < tile_count; ++tile_idx) {
+        HydrologyTile tile = hydrology_tile(width, depth, tile_size, tile_idx);
+        for (u32 i = 0; i < tile_exit_count[tile_idx]; ++i) {
+            u32 idx = exit_cells[tile.cell_offset + i];
+            pending[idx] = 0;
+            exit_inflow[idx] = 0;
+            ++total_exit_count;
+        }
+    }
+
+    u32 *exit_order = allocate<u32>(temp_mem, total_exit_count);
+    u32 exit_order_count = 0;
+
+    for (u32 tile_idx = 0; tile_idx < tile_count; ++tile_idx) {
+        HydrologyTile tile = hydrology_tile(width, depth, tile_size, tile_idx);
+        for (u32 i = 0; i < tile_exit_count[tile_idx]; ++i) {
+            u32 target = flow_target(hydrology, exit_cells[tile.cell_offset + i]);
+            if (target != U32_MAX)
+                ++pending[path_exit[target]];
+        }
+    }
+
+    for (u32 tile_idx = 0; tile_idx < tile_count; ++tile_idx) {
+        HydrologyTile tile = hydrology_tile(width, depth, tile_size, tile_idx);
+        for (u32 i = 0; i < tile_exit_count[tile_idx]; ++i) {
+            u32 idx = exit_cells[tile.cell_offset + i];
+            if (pending[idx] == 0)
+                exit_order[exit_order_count++] = idx;
+        }
+    }
+
+    for (u32 i = 0; i < exit_order_count; ++i) {
+        u32 idx = exit_order[i];
+        u32 target = flow_target(hydrology, idx);
+        if (target == U32_MAX)
+            continue;
+
+        u32 outflow = accumulation[idx] + exit_inflow[idx];
+        u32 target_exit = path_exit[target];
+        inflow[target] += outflow;
+        exit_inflow[target_exit] += outflow;
+
+        if (--pending[target_exit] == 0)
+            exit_order[exit_order_count++] = target_exit;
+    }
+
+    CTK_ASSERT(exit_order_count == total_exit_count);
+
+    // Downstream exits come later in exit_order, so walk it backward to label watersheds by their final cell.
+    for (u32 i = exit_order_count; i-- > 0;) {
+        u32 idx = exit_order[i];
+        u32 target = flow_target(hydrology, idx);
+        watershed[idx] = target == U32_MAX ? idx : watershed[path_exit[target]];
+    }
+
+    // Push seam inflow down tile-local paths.
+    parallel_for(tile_count, [&](u32 tile_idx) {
+        HydrologyTile tile = hydrology_tile(width, depth, tile_size, tile_idx);
+        u32 *tile_order = order + tile.cell_offset;
+        u32 order_count = (tile.max_x - tile.min_x) * (tile.max_z - tile.min_z);
+
+        for (u32 i = 0; i < order_count; ++i) {
+            u32 idx = tile_order[i];
+            u32 target = flow_target(hydrology, idx);
+
+            accumulation[idx] += inflow[idx];
+            watershed[idx] = watershed[path_exit[idx]];
+
+            if (flows_within_tile(hydrology, &tile, target))
+                inflow[target] += inflow[idx];
+        }
+    });
+
+    pop_frame(temp_mem);
+}
+
+// Fills depressions in heightfield, then computes flow directions, flow accumulation, watersheds and the river mask.
+static void generate_hydrology(Memory *temp_mem, Hydrology *hydrology, Heightfield *heightfield, HydrologyInfo info) {
+    fill_depressions(temp_mem, heightfield, info.tile_size);
+    compute_flow_directions(temp_mem, hydrology, heightfield);
+    accumulate_flow(temp_mem, hydrology, info.tile_size);
+
+    parallel_for(hydrology->depth, [&](u32 z) {
+        for (u32 idx = z * hydrology->width; idx < (z + 1) * hydrology->width; ++idx)
+            hydrology->river_mask[idx] = hydrology->accumulation[idx] >= info.river_threshold;
+    });
+}
+
+// Writes RGBA8 display colors: each watershed gets a flat hashed color with rivers drawn over it in blue.
+static void shade_hydrology(Hydrology *hydrology, u32 *pixels) {
+    parallel_for(hydrology->depth, [&](u32 z) {
+        for (u32 idx = z * hydrology->width; idx < (z + 1) * hydrology->width; ++idx) {
+            if (hydrology->river_mask[idx]) {
+                pixels[idx] = 0xFFE08020; // ABGR
+                continue;
+            }
+
+            u32 hash = hydrology->watershed[idx] * 0x9E3779B1;
+            hash ^= hash >> 15;
+            pixels[idx] = 0xFF000000 | (hash & 0x007F7F7F) | 0x00404040;
+        }
+    });
+}
+
+////////////////////////////////////////////////////////////
+/// Biomes
+////////////////////////////////////////////////////////////
+static constexpr u32 MAX_BIOME_CHANNELS = 4; // Channel values are packed 8 bits each into a u32.
+static constexpr u32 BIOME_CHANNEL_VALUE_COUNT = 256;
+
+// Each channel's range is split at the classifier's thresholds for it, so the table holds one entry per combination
+// of ranges and classifies exactly like the classifier. At most 8 ranges per channel keeps the table within 4KB.
+static constexpr u32 MAX_BIOME_THRESHOLDS = 7;
+
+enum struct BiomeChannel {
+    HEIGHT,
+    MOISTURE,
+    TEMPERATURE,
+    RARITY,
+};
+
+enum struct Biome {
+    OCEAN,
+    BEACH,
+    DESERT,
+    SAVANNA,
+    RAINFOREST,
+    GRASSLAND,
+    FOREST,
+    TAIGA,
+    TUNDRA,
+    MOUNTAIN,
+    SNOW,
+    MUSHROOM_FIELDS,
+    COUNT,
+};
+
+typedef u8 (*BiomeClassifyFunc)(f32 *channels);
+
+// Values a classifier compares a channel against, in increasing order.
+struct BiomeThresholds {
+    f32 values[MAX_BIOME_THRESHOLDS];
+    u32 count;
+};
+
+// Thresholds of classify_biome(), indexed by BiomeChannel.
+static constexpr BiomeThresholds DEFAULT_BIOME_THRESHOLDS[] = {
+    { .values = { 0.35f, 0.4f, 0.75f },       .count = 3 },
+    { .values = { 0.35f, 0.45f, 0.5f, 0.6f }, .count = 4 },
+    { .values = { 0.3f, 0.4f, 0.65f },        .count = 3 },
+    { .values = { 0.85f },                    .count = 1 },
+};
+
+// offsets maps each channel's 8-bit value to its range's offset in biomes, so a cell's table index is the sum of its
+// channels' offsets.
+struct BiomeTable {
+    u32 channel_count;
+    u16 offsets[MAX_BIOME_CHANNELS][BIOME_CHANNEL_VALUE_COUNT];
+    u8 *biomes;
+    u32 size;
+};
+
+struct BiomeChannelInfo {
+    // PERMUTATION_SIZE values from generate_noise(). Channels only differ by table and frequency, so channels sharing a
+    // frequency also share lattice coordinates and hashes.
+    Array<f32> *noise;
+    f32 frequency;
+};
+
+struct BiomeInfo {
+    BiomeChannelInfo channels[MAX_BIOME_CHANNELS];
+    u32 channel_count;
+    InterpFunc interp_func;
+    BiomeTable *table; // From create_biome_table() with the same channel_count.
+};
+
+struct BiomeMap {
+    u32 width;
+    u32 depth;
+    u8 *biome;
+    u32 *channels; // Channel i quantized to 8 bits at bit i * 8.
+};
+
+static BiomeMap *create_biome_map(Memory *mem, u32 width, u32 depth) {
+    auto biome_map = allocate<BiomeMap>(mem, 1);
+    biome_map->width = width;
+    biome_map->depth = depth;
+    biome_map->biome = allocate<u8>(mem, width * depth);
+    biome_map->channels = allocate<u32>(mem, width * depth);
+    return biome_map;
+}
+
+// Default classifier for HEIGHT, MOISTURE, TEMPERATURE and RARITY channels.
+static u8 classify_biome(f32 *channels) {
+    f32 height = channels[(u32)BiomeChannel::HEIGHT];
+    f32 moisture = channels[(u32)BiomeChannel::MOISTURE];
+    f32 temperature = channels[(u32)BiomeChannel::TEMPERATURE];
+    f32 rarity = channels[(u32)BiomeChannel::RARITY];
+
+    if (height < 0.35f)
+        return (u8)Biome::OCEAN;
+
+    if (height < 0.4f)
+        return (u8)Biome::BEACH;
+
+    if (height > 0.75f)
+        return temperature < 0.4f ? (u8)Biome::SNOW : (u8)Biome::MOUNTAIN;
+
+    if (rarity > 0.85f && moisture > 0.5f)
+        return (u8)Biome::MUSHROOM_FIELDS;
+
+    if (temperature < 0.3f)
+        return moisture < 0.5f ? (u8)Biome::TUNDRA : (u8)Biome::TAIGA;
+
+    if (temperature > 0.65f) {
+        if (moisture < 0.35f)
+            return (u8)Biome::DESERT;
+
+        return moisture < 0.6f ? (u8)Biome::SAVANNA : (u8)Biome::RAINFOREST;
+    }
+
+    return moisture < 0.45f ? (u8)Biome::GRASSLAND : (u8)Biome::FOREST;
+}
+
+// Precomputes classify_func for every combination of channel ranges between thresholds. classify_func sees the
+// center value of each range, and must only compare channel values against thresholds.
+static BiomeTable *create_biome_table(Memory *mem, u32 channel_count, const BiomeThresholds *thresholds,
+                                      BiomeClassifyFunc classify_func)
+{
+    CTK_ASSERT(channel_count > 0 && channel_count <= MAX_BIOME_CHANNELS);
+
+    auto table = allocate<BiomeTable>(mem, 1);
+    table->channel_count = channel_count;
+
+    u32 strides[MAX_BIOME_CHANNELS] = {};
+    u32 size = 1;
+    for (u32 channel = 0; channel < channel_count; ++channel) {
+        const BiomeThresholds *channel_thresholds = thresholds + channel;
+        CTK_ASSERT(channel_thresholds->count <= MAX_BIOME_THRESHOLDS);
+
+        strides[channel] = size;
+        size *= channel_thresholds->count + 1;
+
+        // A channel value is in the range past every threshold it's at or above.
+        u32 prev_range = 0;
+        for (u32 value = 0; value < BIOME_CHANNEL_VALUE_COUNT; ++value) {
+            u32 range = 0;
+            while (range < channel_thresholds->count &&
+                   value / (BIOME_CHANNEL_VALUE_COUNT - 1.0f) >= channel_thresholds->values[range])
+            {
+                ++range;
+            }
+
+            if (range > prev_range + 1)
+                CTK_FATAL("biome channel %u has a threshold range narrower than its 8-bit quantization", channel);
+
+            table->offsets[channel][value] = (u16)(range * strides[channel]);
+            prev_range = range;
+        }
+    }
+
+    table->size = size;
+    table->biomes = allocate<u8>(mem, size);
+
+    for (u32 table_idx = 0; table_idx < size; ++table_idx) {
+        f32 channels[MAX_BIOME_CHANNELS] = {};
+        for (u32 channel = 0; channel < channel_count; ++channel) {
+            const BiomeThresholds *channel_thresholds = thresholds + channel;
+            u32 range = (table_idx / strides[channel]) % (channel_thresholds->count + 1);
+            f32 range_min = range > 0 ? channel_thresholds->values[range - 1] : 0.0f;
+            f32 range_max = range < channel_thresholds->count ? channel_thresholds->values[range] : 1.0f;
+            channels[channel] = (range_min + range_max) * 0.5f;
+        }
+
+        table->biomes[table_idx] = classify_func(channels);
+    }
+
+    return table;
+}
+
+// Fails if any biome in [0, biome_count) is missing from table, i.e. a classifier branch can never be taken.
+static void validate_biome_table(BiomeTable *table, u32 biome_count) {
+    for (u32 biome = 0; biome < biome_count; ++biome) {
+        u32 table_idx = 0;
+        while (table_idx < table->size && table->biomes[table_idx] != biome)
+            ++table_idx;
+
+        if (table_idx == table->size)
+            CTK_FATAL("biome %u is unreachable from biome table", biome);
+    }
+}
+
+static BiomeTable *create_default_biome_table(Memory *mem) {
+    BiomeTable *table = create_biome_table(mem, MAX_BIOME_CHANNELS, DEFAULT_BIOME_THRESHOLDS, classify_biome);
+    validate_biome_table(table, (u32)Biome::COUNT);
+    return table;
+}
+
+// Samples all channels and classifies each cell in a single traversal. Channels with equal frequencies are grouped so
+// lattice coordinates, interpolation steps and permutation hashes are computed once per group, leaving 4 table reads
+// and 3 lerps per channel.
+static void generate_biome_map(BiomeMap *biome_map, BiomeInfo *info) {
+    CTK_ASSERT(info->channel_count > 0 && info->channel_count <= MAX_BIOME_CHANNELS);
+    CTK_ASSERT(info->table->channel_count == info->channel_count);
+
+    struct ChannelGroup {
+        f32 frequency;
+        u32 channels[MAX_BIOME_CHANNELS];
+        u32 channel_count;
+    };
+
+    ChannelGroup groups[MAX_BIOME_CHANNELS] = {};
+    u32 group_count = 0;
+
+    for (u32 channel = 0; channel < info->channel_count; ++channel) {
+        CTK_ASSERT(info->channels[channel].noise->count >= PERMUTATION_SIZE);
+
+        f32 frequency = info->channels[channel].frequency;
+        u32 group_idx = 0;
+        while (group_idx < group_count && groups[group_idx].frequency != frequency)
+            ++group_idx;
+
+        if (group_idx == group_count) {
+            groups[group_idx].frequency = frequency;
+            ++group_count;
+        }
+
+        ChannelGroup *group = groups + group_idx;
+        group->channels[group->channel_count++] = channel;
+    }
+
+    u32 width = biome_map->width;
+    InterpFunc interp_func = info->interp_func;
+
+    parallel_for(biome_map->depth, [&](u32 z) {
+        // Z lattice coordinates are constant along the row.
+        f32 step_z[MAX_BIOME_CHANNELS];
+        u32 south[MAX_BIOME_CHANNELS];
+        u32 north[MAX_BIOME_CHANNELS];
+
+        for (u32 group_idx = 0; group_idx < group_count; ++group_idx) {
+            f32 sample_z = z / groups[group_idx].frequency;
+            u32 z_floor = (u32)sample_z;
+            step_z[group_idx] = interp_func(sample_z - z_floor);
+            south[group_idx] = z_floor & PERMUTATION_SIZE_MASK;
+            north[group_idx] = (south[group_idx] + 1) & PERMUTATION_SIZE_MASK;
+        }
+
+        for (u32 x = 0; x < width; ++x) {
+            u32 packed = 0;
+            u32 table_idx = 0;
+
+            for (u32 group_idx = 0; group_idx < group_count; ++group_idx) {
+                ChannelGroup *group = groups + group_idx;
+                f32 sample_x = x / group->frequency;
+                u32 x_floor = (u32)sample_x;
+                f32 step_x = interp_func(sample_x - x_floor);
+
+                u32 west = x_floor & PERMUTATION_SIZE_MASK;
+                u32 east = (west + 1) & PERMUTATION_SIZE_MASK;
+                u32 sw = PERMUTATION[PERMUTATION[west] + south[group_idx]];
+                u32 se = PERMUTATION[PERMUTATION[east] + south[group_idx]];
+                u32 nw = PERMUTATION[PERMUTATION[west] + north[group_idx]];
+                u32 ne = PERMUTATION[PERMUTATION[east] + north[group_idx]];
+
+                for (u32 i = 0; i < group->channel_count; ++i) {
+                    u32 channel = group->channels[i];
+                    f32 *vals = info->channels[channel].noise->data;
+                    f32 value = lerp(lerp(vals[sw], vals[se], step_x), lerp(vals[nw], vals[ne], step_x),
+                                     step_z[group_idx]);
+
+                    u32 quantized = (u32)((clamp(value, 0.0f, 1.0f) * 255.0f) + 0.5f);
+                    packed |= quantized << (channel * 8);
+                    table_idx += info->table->offsets[channel][quantized];
+                }
+            }
+
+            u32 idx = (z * width) + x;
+            biome_map->channels[idx] = packed;
+            biome_map->biome[idx] = info->table->biomes[table_idx];
+        }
+    });
+}
+
 #if 0
 public class Perlin {
 